@@ -79,6 +79,9 @@
 /* Define to 1 if you have the 'flock' function. */
 #cmakedefine HAVE_FLOCK 1
 
+/* Define to 1 if you have the 'pread' and 'pwrite' functions. */
+#cmakedefine HAVE_PREAD 1
+
 /* Define to 1 if you have the 'd_type' member in the 'dirent' struct */
 #cmakedefine HAVE_DIRENT_D_TYPE 1
 
@@ -15,6 +15,7 @@ void parse_cmdline( const char *argv );
 // Global variables
 extern bool hatari_borders;
 extern char hatari_frameskips[2];
+extern char hatari_dsp_thread[8];
 
 void Add_Option(const char* option)
 {
@@ -53,6 +54,11 @@ int pre_main(const char *argv)
       Add_Option(hatari_borders==true?"1":"0");
       Add_Option("--frameskips");
       Add_Option(hatari_frameskips);
+      if (strcmp(hatari_dsp_thread, "0") != 0)
+      {
+         Add_Option("--dsp-thread");
+         Add_Option(hatari_dsp_thread);
+      }
       Add_Option("--disk-a");
       Add_Option(RPATH/*ARGUV[0]*/);
    }
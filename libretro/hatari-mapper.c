@@ -37,6 +37,9 @@ extern int Reset_Cold(void);
 long frame=0;
 static unsigned long Ktime=0, LastFPSTime=0;
 
+//FRAME
+static bool frame_changed = true;
+
 //VIDEO
 extern SDL_Surface *sdlscrn; 
 unsigned short int bmp[1024*1024];
@@ -44,7 +47,6 @@ unsigned char savbkg[1024*1024* 2];
 
 //SOUND
 short signed int SNDBUF[1024*2];
-int snd_sampler = 44100 / 50;
 
 //PATH
 char RPATH[512];
@@ -71,6 +73,33 @@ extern int gmx,gmy; //gui mouse
 char Key_Sate[512];
 char Key_Sate2[512];
 
+// Key events from the frontend's keyboard callback, in the order they came.
+// Only the callback writes KeyQueueHead and only Process_key() writes
+// KeyQueueTail, so the queue needs no lock even if the frontend calls
+// us from another thread.
+#define KEY_QUEUE_SIZE 256
+#define KEY_QUEUE_DOWN 0x8000
+#if defined(__GNUC__)
+#define KEY_QUEUE_BARRIER() __sync_synchronize()
+#else
+#define KEY_QUEUE_BARRIER()
+#endif
+static unsigned short KeyQueue[KEY_QUEUE_SIZE];
+static long KeyQueueTime[KEY_QUEUE_SIZE]; // GetTicks() when the event came
+static volatile unsigned KeyQueueHead=0, KeyQueueTail=0;
+bool retro_kbd_callback=false; // frontend sends key events, don't poll keys
+
+// Events of a same batch are given to the IKBD with the same spacing they
+// had on the host, up to one 50 Hz frame in all (in 8 MHz cpu cycles)
+#define KEY_CYCLES_PER_MSEC 8013
+#define KEY_DELAY_MAX (20*KEY_CYCLES_PER_MSEC)
+static int key_delay=0; // cycles between the previous key and the next one
+
+// Poll the input when the IKBD sends its packets rather than before
+// running the frame, see update_input_late()
+bool retro_input_late=false;
+bool input_polled=false;
+
 static int mbt[16]={0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0};
 
 //STATS GUI
@@ -158,26 +187,72 @@ void gui_poll_events(void)
 //save bkg for screenshot
 void save_bkg(void)
 {
-   int i, j, k;	
+   int j, lines, linebytes;
    unsigned char *ptr;
 
-   k = 0;
    ptr = (unsigned char*)sdlscrn->pixels;
 
-   for(j=0;j<retroh;j++)
+   // The surface may be a frontend framebuffer with its own pitch
+   if(ptr == (unsigned char*)bmp)
    {
-      for(i=0;i<retrow*2;i++)
-      {
-         savbkg[k]=*ptr;
-         ptr++;
-         k++;
-      }
+      lines = retroh;
+      linebytes = retrow*2;
    }
+   else
+   {
+      memset(savbkg, 0, retrow*retroh*2);
+      lines = sdlscrn->h;
+      linebytes = sdlscrn->w*2;
+   }
+
+   for(j=0;j<lines;j++)
+      memcpy(&savbkg[j*retrow*2], ptr + j*sdlscrn->pitch, linebytes);
 }
 
 void retro_fillrect(SDL_Surface * surf,SDL_Rect *rect,unsigned int col)
 {
-   DrawFBoxBmp(bmp,rect->x,rect->y,rect->w ,rect->h,col); 
+   int x, y;
+
+   for(y=rect->y;y<rect->y+rect->h;y++)
+   {
+      unsigned short *line = (unsigned short *)((unsigned char *)surf->pixels + y*surf->pitch);
+
+      for(x=rect->x;x<rect->x+rect->w;x++)
+         line[x]=col;
+   }
+}
+
+// Something was drawn to the emulator surface since the last frame went out
+void retro_frame_changed(void)
+{
+   frame_changed = true;
+}
+
+bool retro_frame_take_changed(void)
+{
+   bool changed = frame_changed;
+
+   frame_changed = false;
+   return changed;
+}
+
+// Let the emulator draw into 'pixels' (the bmp buffer when NULL).
+// Returns true if the surface moved, in which case a full redraw is pending.
+bool retro_set_frame_buffer(void *pixels, int pitch)
+{
+   if(!pixels)
+   {
+      pixels = bmp;
+      pitch = retrow*2;
+   }
+
+   if(!sdlscrn || (sdlscrn->pixels == pixels && sdlscrn->pitch == pitch))
+      return false;
+
+   sdlscrn->pixels = pixels;
+   sdlscrn->pitch = pitch;
+   Screen_SetFullUpdate();
+   return true;
 }
 
 int  GuiGetMouseState( int * x,int * y)
@@ -315,58 +390,122 @@ void Print_Statut(void)
 
 void retro_key_down(unsigned char retrok)
 {
-   IKBD_PressSTKey(retrok,1); 
+   IKBD_PressSTKeyAfter(retrok,1,key_delay);
+   key_delay=0;
 }
 
 void retro_key_up(unsigned char retrok)
 {
-   IKBD_PressSTKey(retrok,0);
+   IKBD_PressSTKeyAfter(retrok,0,key_delay);
+   key_delay=0;
 }
 
-void Process_key(void)
+static void Process_key_state(int i, bool pressed)
 {
-   int i;
-   for(i=0;i<320;i++)
-   {
-      Key_Sate[i]=input_state_cb(0, RETRO_DEVICE_KEYBOARD, 0,i) ? 0x80: 0;
+   Key_Sate[i]=pressed ? 0x80: 0;
 
-      if(SDLKeyToSTScanCode[i]==0x2a )
-      {  //SHIFT CASE
+   if(SDLKeyToSTScanCode[i]==0x2a )
+   {  //SHIFT CASE
 
-         if( Key_Sate[i] && Key_Sate2[i]==0 )
-         {
-            if(SHIFTON == 1)
-               retro_key_up(	SDLKeyToSTScanCode[i] );					
-            else if(SHIFTON == -1) 
-               retro_key_down(SDLKeyToSTScanCode[i] );
+      if( Key_Sate[i] && Key_Sate2[i]==0 )
+      {
+         if(SHIFTON == 1)
+            retro_key_up(	SDLKeyToSTScanCode[i] );					
+         else if(SHIFTON == -1) 
+            retro_key_down(SDLKeyToSTScanCode[i] );
 
-            SHIFTON=-SHIFTON;
+         SHIFTON=-SHIFTON;
 
-            Key_Sate2[i]=1;
+         Key_Sate2[i]=1;
 
-         }
-         else if ( !Key_Sate[i] && Key_Sate2[i]==1 )Key_Sate2[i]=0;
+      }
+      else if ( !Key_Sate[i] && Key_Sate2[i]==1 )Key_Sate2[i]=0;
 
+   }
+   else
+   {
+      if(Key_Sate[i] && SDLKeyToSTScanCode[i]!=-1  && Key_Sate2[i]==0)
+      {
+         retro_key_down(	SDLKeyToSTScanCode[i] );
+         Key_Sate2[i]=1;
       }
-      else
+      else if ( !Key_Sate[i] && SDLKeyToSTScanCode[i]!=-1 && Key_Sate2[i]==1 )
       {
-         if(Key_Sate[i] && SDLKeyToSTScanCode[i]!=-1  && Key_Sate2[i]==0)
-         {
-            retro_key_down(	SDLKeyToSTScanCode[i] );
-            Key_Sate2[i]=1;
-         }
-         else if ( !Key_Sate[i] && SDLKeyToSTScanCode[i]!=-1 && Key_Sate2[i]==1 )
-         {
-            retro_key_up( SDLKeyToSTScanCode[i] );
-            Key_Sate2[i]=0;
-
-         }
+         retro_key_up( SDLKeyToSTScanCode[i] );
+         Key_Sate2[i]=0;
 
       }
+
    }
+}
+
+// Called by the frontend for each key press or release
+void retro_keyboard_event(bool down, unsigned keycode, uint32_t character, uint16_t key_modifiers)
+{
+   unsigned head=KeyQueueHead;
 
+   if(keycode==RETROK_UNKNOWN || keycode>=320)
+      return;
+   // Queue full: the emulation isn't running, drop the event
+   if(head-KeyQueueTail>=KEY_QUEUE_SIZE)
+      return;
+
+   KeyQueue[head%KEY_QUEUE_SIZE]=keycode | (down ? KEY_QUEUE_DOWN : 0);
+   KeyQueueTime[head%KEY_QUEUE_SIZE]=GetTicks();
+   KEY_QUEUE_BARRIER();
+   KeyQueueHead=head+1;
+}
+
+// Handle the queued key events. Key presses are dropped when not
+// 'emulating' (GUI shown), so they don't reach the ST later on, but
+// releases are still handled for the keys the ST sees held down.
+// The first event is reported at once, the next ones as many cycles
+// later as they came after it.
+static void Process_key_queue(bool emulating)
+{
+   unsigned tail=KeyQueueTail;
+   unsigned short ev;
+   long time, last=0;
+   int delay, total=0;
+
+   while(tail!=KeyQueueHead)
+   {
+      KEY_QUEUE_BARRIER();
+      ev=KeyQueue[tail%KEY_QUEUE_SIZE];
+      time=KeyQueueTime[tail%KEY_QUEUE_SIZE];
+      if(tail!=KeyQueueTail && time>last)
+      {
+         delay=(time-last)*KEY_CYCLES_PER_MSEC;
+         if(delay>KEY_DELAY_MAX-total)
+            delay=KEY_DELAY_MAX-total;
+         total+=delay;
+         key_delay+=delay;
+      }
+      last=time;
+      tail++;
+      if(emulating || !(ev&KEY_QUEUE_DOWN))
+         Process_key_state(ev&~KEY_QUEUE_DOWN, ev&KEY_QUEUE_DOWN);
+      // (an event that didn't reach the ST leaves its delay to the next one)
+   }
+   key_delay=0;
+   KEY_QUEUE_BARRIER();
+   KeyQueueTail=tail;
 }
 
+void Process_key(void)
+{
+   int i;
+
+   if(retro_kbd_callback)
+   {
+      Process_key_queue(true);
+      return;
+   }
+
+   for(i=0;i<320;i++)
+      Process_key_state(i, input_state_cb(0, RETRO_DEVICE_KEYBOARD, 0,i));
+
+}
 
 /*
    L2  show/hide Statut
@@ -393,7 +532,7 @@ void update_input(void)
    MXjoy0=0;
    if(oldi!=-1)
    {
-      IKBD_PressSTKey(oldi,0);
+      IKBD_PressSTKeyAfter(oldi,0,0);
       oldi=-1;
    }
 
@@ -560,7 +699,7 @@ void update_input(void)
             if(i==0x2a)
             {
 
-               IKBD_PressSTKey(i,(SHIFTON == 1)?0:1);
+               IKBD_PressSTKeyAfter(i,(SHIFTON == 1)?0:1,0);
 
                SHIFTON=-SHIFTON;
 
@@ -571,7 +710,7 @@ void update_input(void)
             else
             {
                oldi=i;
-               IKBD_PressSTKey(i,1);
+               IKBD_PressSTKeyAfter(i,1,0);
             }
          }
       }
@@ -687,12 +826,27 @@ void update_input(void)
       Print_Statut();
 }
 
+// Called by the emulation each time the IKBD is about to send its
+// automatic packets: with late polling, read the input there the first
+// time in the frame, so it's as recent as possible when the ST sees it.
+void update_input_late(void)
+{
+   if(!retro_input_late || input_polled || pauseg!=0)
+      return;
+
+   input_polled=true;
+   update_input();
+}
+
 void input_gui(void)
 {
    int SAVPAS=PAS;	
 
    input_poll_cb();
 
+   if(retro_kbd_callback)
+      Process_key_queue(false);
+
    int mouse_l;
    int mouse_r;
    int16_t mouse_x,mouse_y;
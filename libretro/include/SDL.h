@@ -23,6 +23,7 @@ extern int Reset_Warm(void);
 extern long GetTicks(void);
 
 extern void retro_fillrect(SDL_Surface * surf,SDL_Rect *rect,unsigned int col);
+extern void retro_frame_changed(void);
 extern SDL_Surface *prepare_texture(int w,int h,int b);
 extern int SDL_SaveBMP(SDL_Surface *surface,const char *file);
 
@@ -59,8 +60,8 @@ Uint8 type;
 #define SDL_LockSurface(a) 0
 #define SDL_UnlockSurface(a) 0
 #define SDL_FillRect(s,r,c) retro_fillrect((s),(r),(c))
-#define SDL_UpdateRects(a, b,c)
-#define SDL_UpdateRect(...)
+#define SDL_UpdateRects(a, b,c) retro_frame_changed()
+#define SDL_UpdateRect(...) retro_frame_changed()
 #define SDL_SetVideoMode(w, h, b, f) prepare_texture((w),(h),(b))
 //KEY
 #define SDL_GetError() "RetroWrapper"
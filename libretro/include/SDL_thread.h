@@ -19,6 +19,30 @@ SDL_SemPost
 #include <stdio.h>
 #include <string.h>
 
+#ifdef SDL_THREAD_PROTOTYPES_ONLY
+
+//the functions below are only compiled once, in rs232.c,
+//other users just get the prototypes
+typedef struct SDL_semaphore SDL_sem;
+typedef struct SDL_mutex SDL_mutex;
+typedef struct SDL_Thread SDL_Thread;
+
+extern SDL_sem *SDL_CreateSemaphore(Uint32 initial_value);
+extern void SDL_DestroySemaphore(SDL_sem *sem);
+extern int SDL_SemWait(SDL_sem *sem);
+extern int SDL_SemPost(SDL_sem *sem);
+extern SDL_mutex *SDL_CreateMutex(void);
+extern void SDL_DestroyMutex(SDL_mutex *mutex);
+extern int SDL_mutexP(SDL_mutex *mutex);
+extern int SDL_mutexV(SDL_mutex *mutex);
+extern SDL_Thread *SDL_CreateThread(int (*fn)(void *), void *data);
+extern void SDL_WaitThread(SDL_Thread *thread, int *status);
+
+#define SDL_LockMutex(m)	SDL_mutexP(m)
+#define SDL_UnlockMutex(m)	SDL_mutexV(m)
+
+#else
+
 extern long GetTicks(void);
 
 #define SDL_KillThread(X)
@@ -2436,3 +2460,5 @@ SDL_WaitThread(SDL_Thread * thread, int *status)
 }
 
 #endif
+
+#endif /* SDL_THREAD_PROTOTYPES_ONLY */
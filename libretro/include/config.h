@@ -101,6 +101,11 @@
 
 /* Define to 1 if you have the 'ftello' function. */
 //#define HAVE_FTELLO 1
+
+/* Define to 1 if you have the 'pread' and 'pwrite' functions. */
+#if !defined(__CELLOS_LV2__) && !defined(WIN32PORT) && !defined(WIIU)
+#define HAVE_PREAD 1
+#endif
 #ifdef WIIU
 #define utime(file,time) 0
 #endif
@@ -21,10 +21,11 @@ int CROP_HEIGHT;
 int VIRTUAL_WIDTH ;
 int retrow=1024; 
 int retroh=1024;
+int retro_native_res=0;
 
 extern unsigned short int bmp[1024*1024];
-extern int STATUTON,SHOWKEY,SHIFTON,pauseg,SND ,snd_sampler;
-extern short signed int SNDBUF[1024*2];
+extern SDL_Surface *sdlscrn;
+extern int STATUTON,SHOWKEY,SHIFTON,pauseg,SND;
 extern char RPATH[512];
 extern char RETRO_DIR[512];
 extern char RETRO_TOS[512];
@@ -33,6 +34,16 @@ extern struct retro_midi_interface *MidiRetroInterface;
 #include "cmdline.c"
 
 extern void update_input(void);
+extern bool retro_input_late, input_polled;
+extern bool retro_kbd_callback;
+extern void retro_keyboard_event(bool down, unsigned keycode, uint32_t character, uint16_t key_modifiers);
+extern bool retro_frame_take_changed(void);
+extern bool retro_set_frame_buffer(void *pixels, int pitch);
+extern int Sound_GetRetroSamples(const int16_t **ppSamples, int *pnSamples);
+extern bool bSkipVideoFrame;
+extern bool bRecordingWav;
+extern bool Avi_AreWeRecording(void);
+extern bool bAcsiEmuOn;
 extern void texture_init(void);
 extern void texture_uninit(void);
 extern void Emu_init();
@@ -48,6 +59,13 @@ static retro_audio_sample_batch_t audio_batch_cb;
 static retro_environment_t environ_cb;
 static char buf[64][4096] = { 0 };
 
+/* Frame size last announced to the frontend */
+static unsigned video_width, video_height;
+static bool can_dupe = false;
+
+/* Number of frames emulated ahead of the current one, 0 if disabled */
+static int retro_runahead = 0;
+
 unsigned int video_config = 0;
 #define HATARI_VIDEO_HIRES 	0x04
 #define HATARI_VIDEO_CROP 	0x08
@@ -59,8 +77,9 @@ unsigned int video_config = 0;
 
 bool hatari_borders = true;
 char hatari_frameskips[2];
+char hatari_audio_rate[8] = "44100";
+char hatari_dsp_thread[8] = "0";
 int firstpass = 1;
-char savestate_fname[RETRO_PATH_MAX];
 
 static struct retro_input_descriptor input_descriptors[] = {
    { 0, RETRO_DEVICE_JOYPAD, 0, RETRO_DEVICE_ID_JOYPAD_UP, "Up" },
@@ -108,6 +127,17 @@ void retro_set_environment(retro_environment_t cb)
          },
          "false"
       },  
+      {
+         "hatari_video_native",
+         "Native resolution",
+         "Needs restart. Output the emulated screen at its own size (320 pixels wide in ST low resolution) instead of doubling it",
+         {
+            { "false", "disabled" },
+            { "true", "enabled" },
+            { NULL, NULL },
+         },
+         "false"
+      },
       {
          "hatari_frameskips",
          "Frameskip",
@@ -124,6 +154,59 @@ void retro_set_environment(retro_environment_t cb)
          },
          "0"
       },
+	   // Audio
+      {
+         "hatari_audio_rate",
+         "Audio output rate",
+         "Needs restart. Sound is generated directly at this rate; 50066 Hz is the native STE DMA rate",
+         {
+            { "44100", "44.1 kHz" },
+            { "48000", "48 kHz" },
+            { "22050", "22.05 kHz" },
+            { "50066", "native (50.066 kHz)" },
+            { NULL, NULL },
+         },
+         "44100"
+      },
+	   // Input
+      {
+         "hatari_input_poll",
+         "Input polling",
+         "Read the joypads, mouse and keyboard when the emulated keyboard processor sends them to the ST, instead of before running the frame. Lowers input latency by up to one frame",
+         {
+            { "early", "start of frame" },
+            { "late", "late" },
+            { NULL, NULL },
+         },
+         "early"
+      },
+      {
+         "hatari_runahead",
+         "Run-ahead",
+         "Emulate this many frames ahead of the current one and show the last of them, then go back. Hides the game's own input lag, at the cost of running the emulation once more per frame ahead. Input polling is early when enabled. Not used with GEMDOS, ACSI or IDE hard disks, whose writes can't be undone",
+         {
+            { "0", "disabled" },
+            { "1", NULL },
+            { "2", NULL },
+            { "3", NULL },
+            { NULL, NULL },
+         },
+         "0"
+      },
+	   // System
+      {
+         "hatari_dsp_thread",
+         "Falcon DSP thread",
+         "Needs restart. Run the Falcon DSP on its own thread, at most this many DSP cycles behind the CPU. Faster on multi-core hosts, less accurate timing of DSP interrupts",
+         {
+            { "0", "disabled" },
+            { "1024", NULL },
+            { "4096", NULL },
+            { "16384", NULL },
+            { NULL, NULL },
+         },
+         "0"
+      },
 	  
       { NULL, NULL, NULL, {{0}}, NULL },
 	};
@@ -186,6 +269,17 @@ static void update_variables(void)
 		   video_config |= HATARI_VIDEO_CROP;
    }
 
+   var.key = "hatari_video_native";
+   var.value = NULL;
+
+   if (environ_cb(RETRO_ENVIRONMENT_GET_VARIABLE, &var) && var.value)
+   {
+	   retro_native_res = (strcmp(var.value, "true") == 0);
+	   // Medium and high resolution still need the large buffer
+	   if(retro_native_res)
+		   video_config |= HATARI_VIDEO_HIRES;
+   }
+
    var.key = "hatari_frameskips";
    var.value = NULL;
 
@@ -194,6 +288,41 @@ static void update_variables(void)
 	   strncpy((char*)hatari_frameskips, var.value, 2);
    }
 
+   // Audio
+   var.key = "hatari_audio_rate";
+   var.value = NULL;
+
+   if (environ_cb(RETRO_ENVIRONMENT_GET_VARIABLE, &var) && var.value)
+   {
+	   strncpy(hatari_audio_rate, var.value, sizeof(hatari_audio_rate) - 1);
+   }
+
+   // Input
+   var.key = "hatari_input_poll";
+   var.value = NULL;
+
+   if (environ_cb(RETRO_ENVIRONMENT_GET_VARIABLE, &var) && var.value)
+   {
+	   retro_input_late = (strcmp(var.value, "late") == 0);
+   }
+
+   var.key = "hatari_runahead";
+   var.value = NULL;
+
+   if (environ_cb(RETRO_ENVIRONMENT_GET_VARIABLE, &var) && var.value)
+   {
+	   retro_runahead = atoi(var.value);
+   }
+
+   // System
+   var.key = "hatari_dsp_thread";
+   var.value = NULL;
+
+   if (environ_cb(RETRO_ENVIRONMENT_GET_VARIABLE, &var) && var.value)
+   {
+	   strncpy(hatari_dsp_thread, var.value, sizeof(hatari_dsp_thread) - 1);
+   }
+
    switch(video_config)
    {
 		case HATARI_VIDEO_OV_LO:
@@ -480,6 +609,10 @@ void retro_init(void)
 	};
 	environ_cb(RETRO_ENVIRONMENT_SET_INPUT_DESCRIPTORS, &inputDescriptors);
 
+   // Keyboard events, else the keys are polled each frame
+   static struct retro_keyboard_callback kbd_callback = { retro_keyboard_event };
+   retro_kbd_callback = environ_cb(RETRO_ENVIRONMENT_SET_KEYBOARD_CALLBACK, &kbd_callback);
+
    static struct retro_midi_interface midi_interface;
 
    if(environ_cb(RETRO_ENVIRONMENT_GET_MIDI_INTERFACE, &midi_interface))
@@ -490,6 +623,9 @@ void retro_init(void)
  	// Disk control interface
 	environ_cb(RETRO_ENVIRONMENT_SET_DISK_CONTROL_INTERFACE, &disk_interface);
 
+   if (!environ_cb(RETRO_ENVIRONMENT_GET_CAN_DUPE, &can_dupe))
+      can_dupe = false;
+
    // Savestates
    static uint32_t quirks = RETRO_SERIALIZATION_QUIRK_INCOMPLETE | RETRO_SERIALIZATION_QUIRK_MUST_INITIALIZE | RETRO_SERIALIZATION_QUIRK_CORE_VARIABLE_SIZE;
    environ_cb(RETRO_ENVIRONMENT_SET_SERIALIZATION_QUIRKS, &quirks);
@@ -544,10 +680,42 @@ void retro_get_system_info(struct retro_system_info *info)
 
 }
 
+// Size of the frame handed to video_cb
+static void retro_frame_size(unsigned *width, unsigned *height)
+{
+   *width  = 640;
+   *height = 400;
+
+   if(SHOWKEY==1 || STATUTON==1 || pauseg==1)
+   {
+      // Overlays are drawn for the whole buffer
+      *width  = retrow;
+      *height = retroh;
+   }
+   else if(retro_native_res && sdlscrn)
+   {
+      *width  = sdlscrn->w < retrow ? sdlscrn->w : retrow;
+      *height = sdlscrn->h < retroh ? sdlscrn->h : retroh;
+   }
+   else if(ConfigureParams.Screen.bAllowOverscan)
+   {
+      *width  = retrow;
+      *height = retroh;
+   }
+}
+
 void retro_get_system_av_info(struct retro_system_av_info *info)
 {
-   struct retro_game_geometry geom = { retrow, retroh, 1024, 1024, 4.0 / 3.0 };
-   struct retro_system_timing timing = { 50.0, 44100.0 };
+   if(retro_native_res)
+      retro_frame_size(&video_width, &video_height);
+   else
+   {
+      video_width  = retrow;
+      video_height = retroh;
+   }
+
+   struct retro_game_geometry geom = { video_width, video_height, 1024, 1024, 4.0 / 3.0 };
+   struct retro_system_timing timing = { 50.0, atoi(hatari_audio_rate) };
 
    info->geometry = geom;
    info->timing   = timing;
@@ -568,38 +736,203 @@ void retro_set_video_refresh(retro_video_refresh_t cb)
    video_cb = cb;
 }
 
+// Ask the frontend for a buffer the emulator surface fits in
+static bool retro_get_frame_buffer(struct retro_framebuffer *fb, unsigned width, unsigned height)
+{
+   // Overlays and the GUI are drawn in our own buffer
+   if(SHOWKEY==1 || STATUTON==1 || pauseg==1 || !sdlscrn)
+      return false;
+
+   fb->width        = width;
+   fb->height       = height;
+   fb->access_flags = RETRO_MEMORY_ACCESS_WRITE;
+
+   if(!environ_cb(RETRO_ENVIRONMENT_GET_CURRENT_SOFTWARE_FRAMEBUFFER, fb) || !fb->data)
+      return false;
+
+   if(fb->format != RETRO_PIXEL_FORMAT_RGB565 || fb->width != width || fb->height != height)
+      return false;
+
+   return sdlscrn->w <= (int)fb->width && sdlscrn->h <= (int)fb->height
+      && sdlscrn->w*2 <= (int)fb->pitch;
+}
+
+// Hand the current frame to the frontend. 'fb' is the frontend buffer
+// requested for a frame of fb_width x fb_height, if any.
+static void retro_present(void *fb, unsigned fb_width, unsigned fb_height, bool dupe)
+{
+   unsigned width, height;
+   bool changed = retro_frame_take_changed();
+
+   retro_frame_size(&width, &height);
+   if(width != video_width || height != video_height)
+   {
+      struct retro_game_geometry geom = { width, height, 1024, 1024, 4.0 / 3.0 };
+
+      environ_cb(RETRO_ENVIRONMENT_SET_GEOMETRY, &geom);
+      video_width  = width;
+      video_height = height;
+      changed = true;
+   }
+
+   if(SHOWKEY==1 || STATUTON==1 || pauseg==1)
+      video_cb(bmp, width, height, retrow<< 1);
+   else if(sdlscrn->pixels == fb && (width != fb_width || height != fb_height))
+      // The frame no longer matches the buffer that was handed out
+      video_cb(NULL, width, height, sdlscrn->pitch);
+   else if((!changed || dupe) && can_dupe)
+      // Nothing new was drawn, or our buffer is stale since the emulator left it
+      video_cb(NULL, width, height, sdlscrn->pitch);
+   else
+      video_cb(sdlscrn->pixels, width, height, sdlscrn->pitch);
+}
+
+// Give the samples of the last emulated frame to the frontend
+static void retro_audio_output(void)
+{
+   const int16_t *samples[2];
+   int lens[2];
+   int x, parts;
+
+   parts = Sound_GetRetroSamples(samples, lens);
+
+   if(SND==1)
+      for(x = 0; x < parts; x++)
+         audio_batch_cb(samples[x], lens[x]);
+}
+
+// Run-ahead can't undo what was recorded, sent to MIDI devices or
+// written to hard disks (host files and images)
+static bool retro_can_run_ahead(void)
+{
+   if(retro_runahead <= 0 || pauseg!=0)
+      return false;
+   if(bRecordingWav || Avi_AreWeRecording())
+      return false;
+   if(ConfigureParams.HardDisk.bUseHardDiskDirectories || bAcsiEmuOn
+      || ConfigureParams.HardDisk.bUseIdeMasterHardDiskImage
+      || ConfigureParams.HardDisk.bUseIdeSlaveHardDiskImage)
+      return false;
+   if(MidiRetroInterface && (MidiRetroInterface->output_enabled() || MidiRetroInterface->input_enabled()))
+      return false;
+   return true;
+}
+
+static void *checkpoint = NULL;
+static size_t checkpoint_max = 0;
+
+// Make room for the checkpoint before the current frame is emulated
+// without drawing it: past that point, running ahead can't be given up.
+// Its size only changes with the configuration, it's measured again
+// after a checkpoint couldn't be saved.
+static bool retro_run_ahead_prepare(void)
+{
+   size_t size;
+   void *p;
+
+   if(checkpoint_max > 0)
+      return true;
+
+   size = MemorySnapShot_GetCheckpointSize();
+   p = realloc(checkpoint, size);
+   if(!p)
+      return false;
+   checkpoint = p;
+   checkpoint_max = size;
+   return true;
+}
+
+// Emulate the frames following the one just done, draw only the last of
+// them, and go back to the checkpoint saved after the current frame.
+// Its sound is output first: the sound of the frames ahead is dropped.
+// Return false if no checkpoint could be saved, nothing was emulated then.
+static bool retro_run_ahead(void)
+{
+   const int16_t *samples[2];
+   int lens[2];
+   size_t size;
+   int i;
+
+   retro_audio_output();
+
+   size = MemorySnapShot_CaptureCheckpoint(checkpoint, checkpoint_max);
+   if(size == 0)
+   {
+      checkpoint_max = 0;
+      return false;
+   }
+
+   for(i = 0; i < retro_runahead && pauseg==0; i++)
+   {
+      bSkipVideoFrame = (i < retro_runahead - 1);
+      co_switch(emuThread);
+   }
+   bSkipVideoFrame = false;
+
+   Sound_GetRetroSamples(samples, lens);
+   MemorySnapShot_RestoreCheckpoint(checkpoint, size);
+   return true;
+}
+
 void retro_run(void)
 {
-   int x;
-   unsigned width = 640;
-   unsigned height = 400;
+   unsigned width, height;
+   struct retro_framebuffer fb = { 0 };
+   bool direct, moved, ahead, late;
 
    bool updated = false;
 
    if (environ_cb(RETRO_ENVIRONMENT_GET_VARIABLE_UPDATE, &updated) && updated)
       update_variables();
 
+   ahead = retro_can_run_ahead() && retro_run_ahead_prepare();
+   // The frames ahead would all see the input of the current one anyway
+   late = retro_input_late && !ahead;
+
    if(pauseg==0)
    {
-      update_input();
+      // Polled late, the input is read by the emulation itself
+      if(late)
+         input_polled=false;
+      else
+         update_input();
 
-      if(SND==1)
-      {
-         int16_t *p=(int16_t*)SNDBUF;
-
-         for(x = 0; x < snd_sampler; x++)
-            audio_cb(*p++,*p++);
-      }
+      retro_audio_output();
    }
 
-   if(ConfigureParams.Screen.bAllowOverscan || SHOWKEY==1 || STATUTON==1 || pauseg==1 )
+   // Let the emulator draw straight into the frontend's buffer when we can,
+   // and hand that frame over as soon as the emulation of it is done
+   retro_frame_size(&width, &height);
+   direct = retro_get_frame_buffer(&fb, width, height);
+
+   // The GUI saves the emulator screen on entry, so leave the surface alone
+   if(pauseg==1)
+      moved = false;
+   else
+      moved = retro_set_frame_buffer(direct ? fb.data : NULL, fb.pitch);
+
+   if(!direct)
+      retro_present(NULL, 0, 0, moved);
+
+   // The current frame is only drawn when not running ahead
+   bSkipVideoFrame = ahead;
+   co_switch(emuThread);
+   bSkipVideoFrame = false;
+
+   // Without a checkpoint, draw the next frame instead, its sound is
+   // output with the one of the next retro_run()
+   if(ahead && pauseg==0 && !retro_run_ahead())
+      co_switch(emuThread);
+
+   // Nothing was sent by the IKBD in this frame, read the input for the next one
+   if(late && pauseg==0 && !input_polled)
    {
-      width  = retrow;
-      height = retroh;
+      input_polled=true;
+      update_input();
    }
-   video_cb(bmp, width, height, retrow<< 1);
 
-   co_switch(emuThread);
+   if(direct)
+      retro_present(fb.data, width, height, false);
 
    if (MidiRetroInterface && MidiRetroInterface->output_enabled())
       MidiRetroInterface->flush();
@@ -682,17 +1015,8 @@ size_t retro_serialize_size(void)
 {
    if (firstpass != 1)
    {
-      snprintf(savestate_fname, sizeof(savestate_fname), "%s%shatari_tempsave.uss", retro_save_directory, RETRO_PATH_SEPARATOR);
-      MemorySnapShot_Capture(savestate_fname, false);
-	  FILE *file = fopen(savestate_fname, "rb");
-	  if (file)
-	  {
-		 size_t size = 0;
-		 fseek(file, 0L, SEEK_END);
-		 size = ftell(file);
-		 fclose(file);
-		 return size;
-	  }
+      // Fixed layout, size only changes with the machine config
+      return MemorySnapShot_GetMemorySize();
    }
    return 0;
 }
@@ -701,18 +1025,8 @@ bool retro_serialize(void *data_, size_t size)
 {
    if (firstpass != 1)
    {
-      snprintf(savestate_fname, sizeof(savestate_fname), "%s%shatari_tempsave.uss", retro_save_directory, RETRO_PATH_SEPARATOR);
-      MemorySnapShot_Capture(savestate_fname, false);
-	  FILE *file = fopen(savestate_fname, "rb");
-	  if (file)
-	  {
-		 if (fread(data_, size, 1, file) == 1)
-		 {
-		    fclose(file);
-		    return true;
-		 }
-		 fclose(file);
-	  }
+      if (MemorySnapShot_CaptureMemory(data_, size))
+         return true;
    }
    return false;
 }
@@ -720,21 +1034,7 @@ bool retro_serialize(void *data_, size_t size)
 bool retro_unserialize(const void *data_, size_t size)
 {
    if (firstpass != 1)
-   {
-      snprintf(savestate_fname, sizeof(savestate_fname), "%s%shatari_tempsave.uss", retro_save_directory, RETRO_PATH_SEPARATOR);
-      FILE *file = fopen(savestate_fname, "wb");
-      if (file)
-      {
-         if (fwrite(data_, size, 1, file) == 1)
-         {
-            fclose(file);
-            MemorySnapShot_Restore(savestate_fname, false);
-            return true;
-         }
-         else
-            fclose(file);
-      }
-   }
+      return MemorySnapShot_RestoreMemory(data_, size);
    return false;
 }
 
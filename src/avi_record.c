@@ -20,10 +20,18 @@
      and much less disk bandwidth. Compression levels 3 or 4 give good
      tradeoff between cpu usage and file size and should not slow down Hatari
      with recent computers.
+   - ZLIB : RGB images compressed with zlib at its fastest level (same format
+     as the LCL 'ZLIB' codec, as decoded by ffmpeg/libavcodec). Lossless and
+     much smaller than BMP, while using far less cpu than PNG.
 
   PNG compression will often give a x20 ratio when compared to BMP and should
   be used if you have a powerful enough cpu.
 
+  Frames are only copied by the emulation thread : compression is done by
+  several encoding threads and a writer thread stores the resulting chunks
+  in the file in the same order as they were recorded. The index of all
+  the chunks is kept in memory and written when recording stops.
+
   Sound is saved as 16 bits pcm stereo, using the current Hatari sound output
   frequency. For best accuracy, sound frequency should be a multiple of the
   video frequency ; this means 44.1 kHz is the best choice for 50/60 Hz video.
@@ -57,6 +65,11 @@ const char AVIRecord_fileid[] = "Hatari avi_record.c : " __DATE__ " " __TIME__;
 
 #include <SDL.h>
 #include <SDL_endian.h>
+#ifdef __LIBRETRO__
+#define SDL_THREAD_PROTOTYPES_ONLY			/* already implemented in rs232.c */
+#endif
+#include <SDL_thread.h>
+#include <zlib.h>
 
 #include "main.h"
 #include "version.h"
@@ -135,6 +148,8 @@ typedef struct
 	Uint8			ypels_meter[4];
 	Uint8			clr_used[4];
 	Uint8			clr_important[4];
+
+	Uint8			extra_data[8];		/* codec's data for 'ZLIB', else an empty 'JUNK' chunk */
 } AVI_STREAM_FORMAT_VIDS;
 
 typedef struct
@@ -254,6 +269,10 @@ typedef struct {
 
 #define	VIDEO_STREAM_RGB			0x00000000			/* fourcc for BMP video frames */
 #define	VIDEO_STREAM_PNG			"MPNG"				/* fourcc for PNG video frames */
+#define	VIDEO_STREAM_ZLIB			"ZLIB"				/* fourcc for zlib video frames */
+
+#define	VIDEO_STREAM_ZLIB_IMGTYPE_RGB24		2				/* 'ZLIB' extra data : 24 bits BGR frames */
+#define	VIDEO_STREAM_ZLIB_CODEC			3				/* 'ZLIB' extra data : zlib (not mszh) */
 
 #define	AVIF_HASINDEX				0x00000010			/* index at the end of the file */
 #define	AVIF_ISINTERLEAVED			0x00000100			/* data are interleaved */
@@ -262,10 +281,42 @@ typedef struct {
 #define	AVIIF_KEYFRAME				0x00000010			/* frame is a keyframe */
 
 
+#define	AVI_RECORD_JOBS				8				/* frames/samples waiting to be written */
+#define	AVI_RECORD_ENCODERS			3				/* number of encoding threads */
+
+#define	AVI_JOB_VIDEO				1
+#define	AVI_JOB_AUDIO				2
+#define	AVI_JOB_END				3				/* last job, sent when recording stops */
+
+
+typedef struct {
+  int		Type;					/* AVI_JOB_xxx */
+
+  /* Copy of the cropped video frame, made by the emulation thread */
+  SDL_Surface	Surface;				/* points to Pixels / Format below */
+  SDL_PixelFormat Format;
+  SDL_Palette	Palette;
+  SDL_Color	Colors[ 256 ];
+  Uint8		*Pixels;
+  int		PixelsAlloc;
+
+  z_stream	ZStream;				/* for the zlib codec */
+  bool		ZStreamInit;
+
+  /* Chunk to write, filled by an encoder (or directly by the emulation thread for audio) */
+  const char	*ChunkName;
+  Uint8		*Data;
+  int		DataSize;
+  int		DataAlloc;
+  bool		Error;
+  SDL_sem	*Encoded;				/* posted when Data can be written */
+} AVI_JOB;
+
+
 typedef struct {
   /* Input params to start recording */
   int		VideoCodec;
-  int		VideoCodecCompressionLevel;					/* 0-9 for png compression */
+  int		VideoCodecCompressionLevel;					/* 0-9 for png/zlib compression */
 
   SDL_Surface	*Surface;
 
@@ -289,6 +340,26 @@ typedef struct {
   int		TotalAudioSamples;			/* number of recorded audio samples */
   long		MoviChunkPosStart;			/* as returned by ftell() */
   long		MoviChunkPosEnd;			/* as returned by ftell() */
+
+  /* Jobs are filled in order by the emulation thread, encoded by any of the */
+  /* encoding threads and written in the same order by the writer thread */
+  AVI_JOB	Jobs[ AVI_RECORD_JOBS ];
+  Uint32	JobsQueued;				/* emulation thread : number of jobs queued */
+  Uint32	JobsTaken;				/* encoders : number of jobs taken (JobsLock) */
+  SDL_sem	*JobsFree;				/* number of jobs that can be filled */
+  SDL_sem	*JobsReady;				/* number of jobs waiting for an encoder */
+  SDL_mutex	*JobsLock;
+  SDL_Thread	*EncoderThreads[ AVI_RECORD_ENCODERS ];
+  SDL_Thread	*WriterThread;
+  volatile bool	ThreadsQuit;
+  volatile bool	WriteError;				/* set by the writer thread */
+  bool		WriteErrorReported;
+
+  /* Only used by the writer thread until it stops */
+  long		MoviPos;				/* pos of the next chunk, relative to 'movi' */
+  AVI_CHUNK_INDEX *Index;				/* entries for the 'idx1' chunk */
+  int		IndexCount;
+  int		IndexAlloc;
 } RECORD_AVI_PARAMS;
 
 
@@ -303,15 +374,27 @@ static AVI_FILE_HEADER		AviFileHeader;
 static void	Avi_StoreU16 ( Uint8 *p , Uint16 val );
 static void	Avi_StoreU32 ( Uint8 *p , Uint32 val );
 static void	Avi_Store4cc ( Uint8 *p , const char *text );
-static Uint32	Avi_ReadU32 ( Uint8 *p );
 
 static int	Avi_GetBmpSize ( int Width , int Height , int BitCount );
+static bool	Avi_GrowBuffer ( Uint8 **ppBuf , int *pAlloc , int Size );
 
-static bool	Avi_RecordVideoStream_BMP ( RECORD_AVI_PARAMS *pAviParams );
+static void	Avi_ConvertLine_BGR ( SDL_Surface *pSurface , int y , Uint8 *pOut );
+static bool	Avi_EncodeVideoFrame_BMP ( RECORD_AVI_PARAMS *pAviParams , AVI_JOB *pJob );
 #if HAVE_LIBPNG
-static bool	Avi_RecordVideoStream_PNG ( RECORD_AVI_PARAMS *pAviParams );
+static bool	Avi_EncodeVideoFrame_PNG ( RECORD_AVI_PARAMS *pAviParams , AVI_JOB *pJob );
 #endif
-static bool	Avi_RecordAudioStream_PCM ( RECORD_AVI_PARAMS *pAviParams , Sint16 pSamples[][2], int SampleIndex, int SampleLength );
+static bool	Avi_EncodeVideoFrame_ZLIB ( RECORD_AVI_PARAMS *pAviParams , AVI_JOB *pJob );
+static bool	Avi_CopyVideoFrame ( RECORD_AVI_PARAMS *pAviParams , AVI_JOB *pJob );
+static bool	Avi_RecordAudioStream_PCM ( RECORD_AVI_PARAMS *pAviParams , AVI_JOB *pJob , Sint16 pSamples[][2], int SampleIndex, int SampleLength );
+
+static AVI_JOB	*Avi_GetFreeJob ( RECORD_AVI_PARAMS *pAviParams );
+static void	Avi_QueueJob ( RECORD_AVI_PARAMS *pAviParams );
+static bool	Avi_CheckWriteError ( RECORD_AVI_PARAMS *pAviParams );
+static int	Avi_EncoderThread ( void *pData );
+static bool	Avi_WriteChunk ( RECORD_AVI_PARAMS *pAviParams , AVI_JOB *pJob );
+static int	Avi_WriterThread ( void *pData );
+static bool	Avi_StartThreads ( RECORD_AVI_PARAMS *pAviParams );
+static void	Avi_StopThreads ( RECORD_AVI_PARAMS *pAviParams );
 
 static void	Avi_BuildFileHeader ( RECORD_AVI_PARAMS *pAviParams , AVI_FILE_HEADER *pAviFileHeader );
 static bool	Avi_BuildIndex ( RECORD_AVI_PARAMS *pAviParams );
@@ -348,157 +431,232 @@ static void	Avi_Store4cc ( Uint8 *p , const char *text )
 }
 
 
-static Uint32	Avi_ReadU32 ( Uint8 *p )
+static int	Avi_GetBmpSize ( int Width , int Height , int BitCount )
 {
-	return (p[3]<<24) + (p[2]<<16) + (p[1]<<8) +p[0];
+	return ( Width * Height * BitCount / 8 );						/* bytes in one video frame */
 }
 
 
-static int	Avi_GetBmpSize ( int Width , int Height , int BitCount )
+
+/*-----------------------------------------------------------------------*/
+/**
+ * Make sure *ppBuf can hold at least Size bytes, reallocating it if needed.
+ * Return false if there's not enough memory.
+ */
+static bool	Avi_GrowBuffer ( Uint8 **ppBuf , int *pAlloc , int Size )
 {
-	return ( Width * Height * BitCount / 8 );						/* bytes in one video frame */
+	Uint8	*pNewBuf;
+
+	if ( Size <= *pAlloc )
+		return true;
+
+	pNewBuf = realloc ( *ppBuf , Size );
+	if ( !pNewBuf )
+		return false;
+
+	*ppBuf = pNewBuf;
+	*pAlloc = Size;
+	return true;
 }
 
 
 
-static bool	Avi_RecordVideoStream_BMP ( RECORD_AVI_PARAMS *pAviParams )
+/*-----------------------------------------------------------------------*/
+/**
+ * Convert line y of a video frame to 24-bit BGR format
+ */
+static void	Avi_ConvertLine_BGR ( SDL_Surface *pSurface , int y , Uint8 *pOut )
+{
+	Uint8	*pIn = (Uint8 *)pSurface->pixels + y * pSurface->pitch;
+
+	switch ( pSurface->format->BytesPerPixel ) {
+		case 1 :	PixelConvert_8to24Bits_BGR(pOut, pIn, pSurface->w, pSurface->format->palette->colors);
+				break;
+		case 2 :	PixelConvert_16to24Bits_BGR(pOut, (Uint16 *)pIn, pSurface->w, pSurface->format);
+				break;
+		case 3 :	PixelConvert_24to24Bits_BGR(pOut, pIn, pSurface->w);
+				break;
+		case 4 :	PixelConvert_32to24Bits_BGR(pOut, (Uint32 *)pIn, pSurface->w, pSurface->format);
+				break;
+	}
+}
+
+
+
+/*-----------------------------------------------------------------------*/
+/**
+ * Encoding threads : convert the copy of a video frame to an uncompressed BMP image
+ */
+static bool	Avi_EncodeVideoFrame_BMP ( RECORD_AVI_PARAMS *pAviParams , AVI_JOB *pJob )
 {
-	AVI_CHUNK	Chunk;
 	int		SizeImage;
-	Uint8		LineBuf[ 3 * pAviParams->Width ];			/* temp buffer to convert to 24-bit BGR format */
-	Uint8		*pBitmapIn , *pBitmapOut;
+	Uint8		*pBitmapOut;
 	int		y;
-	int		NeedLock;
-	
+
 	SizeImage = Avi_GetBmpSize ( pAviParams->Width , pAviParams->Height , pAviParams->BitCount );
+	if ( !Avi_GrowBuffer ( &pJob->Data , &pJob->DataAlloc , SizeImage ) )
+		return false;
 
-	/* Write the video frame header */
-	Avi_Store4cc ( Chunk.ChunkName , "00db" );				/* stream 0, uncompressed DIB bytes */
-	Avi_StoreU32 ( Chunk.ChunkSize , SizeImage );					/* max size of RGB image */
-	if ( fwrite ( &Chunk , sizeof ( Chunk ) , 1 , pAviParams->FileOut ) != 1 )
+	/* For BMP format, frame is stored from bottom to top (origin is in bottom left corner) */
+	/* and bytes are in BGR order (not RGB) */
+	pBitmapOut = pJob->Data;
+	for ( y = pAviParams->Height-1 ; y >= 0 ; y-- )
 	{
-		perror ( "Avi_RecordVideoStream_BMP" );
-		Log_AlertDlg ( LOG_ERROR, "AVI recording : failed to write bmp frame header" );
-		return false;
+		Avi_ConvertLine_BGR ( &pJob->Surface , y , pBitmapOut );
+		pBitmapOut += pAviParams->Width * 3;
 	}
 
+	pJob->ChunkName = "00db";						/* stream 0, uncompressed DIB bytes */
+	pJob->DataSize = SizeImage;
+	return true;
+}
 
-	/* Write the video frame data */
-	NeedLock = SDL_MUSTLOCK( pAviParams->Surface );
 
-	/* Points to the top left pixel after cropping borders */
-	/* For BMP format, frame is stored from bottom to top (origin is in bottom left corner) */
-	/* and bytes are in BGR order (not RGB) */
-	pBitmapIn = (Uint8 *)pAviParams->Surface->pixels
-			+ pAviParams->Surface->pitch * ( pAviParams->CropTop + pAviParams->Height )
-			+ pAviParams->CropLeft * pAviParams->Surface->format->BytesPerPixel;
 
-	for ( y=0 ; y<pAviParams->Height ; y++ )
-	{
-		if ( NeedLock )
-			SDL_LockSurface ( pAviParams->Surface );
-
-		pBitmapOut = LineBuf;
-		switch ( pAviParams->Surface->format->BytesPerPixel ) {
-			case 1 :	PixelConvert_8to24Bits_BGR(LineBuf, pBitmapIn, pAviParams->Width, pAviParams->Surface->format->palette->colors);
-					break;
-			case 2 :	PixelConvert_16to24Bits_BGR(LineBuf, (Uint16 *)pBitmapIn, pAviParams->Width, pAviParams->Surface->format);
-					break;
-			case 3 :	PixelConvert_24to24Bits_BGR(LineBuf, pBitmapIn, pAviParams->Width);
-					break;
-			case 4 :	PixelConvert_32to24Bits_BGR(LineBuf, (Uint32 *)pBitmapIn, pAviParams->Width, pAviParams->Surface->format);
-					break;
-		}
+#if HAVE_LIBPNG
+/*-----------------------------------------------------------------------*/
+/**
+ * Encoding threads : compress the copy of a video frame to a PNG image
+ */
+static bool	Avi_EncodeVideoFrame_PNG ( RECORD_AVI_PARAMS *pAviParams , AVI_JOB *pJob )
+{
+	int		SizeImage;
 
-		if ( NeedLock )
-			SDL_UnlockSurface ( pAviParams->Surface );
+	SizeImage = ScreenSnapShot_SavePNG_ToMemory ( &pJob->Surface , &pJob->Data , &pJob->DataAlloc ,
+		pAviParams->VideoCodecCompressionLevel , PNG_FILTER_NONE , 0 , 0 , 0 , 0 );
+	if ( SizeImage <= 0 )
+		return false;
 
-		if ( (int)fwrite ( pBitmapOut , 1 , pAviParams->Width*3 , pAviParams->FileOut ) != pAviParams->Width*3 )
-		{
-			perror ( "Avi_RecordVideoStream_BMP" );
-			Log_AlertDlg ( LOG_ERROR, "AVI recording : failed to write bmp video frame" );
+	pJob->ChunkName = "00dc";						/* stream 0, compressed DIB bytes */
+	pJob->DataSize = SizeImage;
+	return true;
+}
+#endif  /* HAVE_LIBPNG */
+
+
+
+/*-----------------------------------------------------------------------*/
+/**
+ * Encoding threads : compress the copy of a video frame with zlib.
+ * The frame is stored as for BMP (24-bit BGR, from bottom to top) in
+ * a single zlib stream.
+ */
+static bool	Avi_EncodeVideoFrame_ZLIB ( RECORD_AVI_PARAMS *pAviParams , AVI_JOB *pJob )
+{
+	z_stream	*pZStream = &pJob->ZStream;
+	Uint8		LineBuf[ 3 * pAviParams->Width ];			/* temp buffer to convert to 24-bit BGR format */
+	int		SizeMax;
+	int		y;
+
+	if ( !pJob->ZStreamInit )
+	{
+		memset ( pZStream , 0 , sizeof ( *pZStream ) );
+		if ( deflateInit ( pZStream , pAviParams->VideoCodecCompressionLevel ) != Z_OK )
 			return false;
-		}
+		pJob->ZStreamInit = true;
+	}
+	else if ( deflateReset ( pZStream ) != Z_OK )
+		return false;
 
-		pBitmapIn -= pAviParams->Surface->pitch;			/* go from bottom to top */
+	SizeMax = deflateBound ( pZStream , Avi_GetBmpSize ( pAviParams->Width , pAviParams->Height , pAviParams->BitCount ) );
+	if ( !Avi_GrowBuffer ( &pJob->Data , &pJob->DataAlloc , SizeMax ) )
+		return false;
+
+	pZStream->next_out = pJob->Data;
+	pZStream->avail_out = SizeMax;
+	for ( y = pAviParams->Height-1 ; y >= 0 ; y-- )
+	{
+		Avi_ConvertLine_BGR ( &pJob->Surface , y , LineBuf );
+		pZStream->next_in = LineBuf;
+		pZStream->avail_in = pAviParams->Width * 3;
+		if ( deflate ( pZStream , y == 0 ? Z_FINISH : Z_NO_FLUSH ) == Z_STREAM_ERROR )
+			return false;
 	}
+	if ( pZStream->avail_in != 0 )						/* can't happen with deflateBound() */
+		return false;
 
+	pJob->ChunkName = "00dc";						/* stream 0, compressed DIB bytes */
+	pJob->DataSize = pZStream->total_out;
 	return true;
 }
 
 
 
-#if HAVE_LIBPNG
-static bool	Avi_RecordVideoStream_PNG ( RECORD_AVI_PARAMS *pAviParams )
+/*-----------------------------------------------------------------------*/
+/**
+ * Copy the cropped video frame (and its palette for 8-bit surfaces)
+ * into pJob, so it can be encoded while emulation continues.
+ */
+static bool	Avi_CopyVideoFrame ( RECORD_AVI_PARAMS *pAviParams , AVI_JOB *pJob )
 {
-	AVI_CHUNK	Chunk;
-	int		SizeImage;
-	long		ChunkPos;
-	Uint8	TempSize[4];
-	
+	SDL_Surface	*pSurface = pAviParams->Surface;
+	SDL_PixelFormat	*pFormat = pSurface->format;
+	int		LineSize = pAviParams->Width * pFormat->BytesPerPixel;
+	Uint8		*pBitmapIn , *pBitmapOut;
+	int		y;
+	int		NeedLock;
 
-	/* Write the video frame header */
-	ChunkPos = ftell ( pAviParams->FileOut );
-	Avi_Store4cc ( Chunk.ChunkName , "00dc" );				/* stream 0, compressed DIB bytes */
-	Avi_StoreU32 ( Chunk.ChunkSize , 0 );					/* size of PNG image (-> completed later) */
-	if ( fwrite ( &Chunk , sizeof ( Chunk ) , 1 , pAviParams->FileOut ) != 1 )
-		goto png_error;
+	if ( !Avi_GrowBuffer ( &pJob->Pixels , &pJob->PixelsAlloc , LineSize * pAviParams->Height ) )
+		return false;
 
-	/* Write the video frame data */
-	SizeImage = ScreenSnapShot_SavePNG_ToFile ( pAviParams->Surface , pAviParams->FileOut ,
-		pAviParams->VideoCodecCompressionLevel , PNG_FILTER_NONE ,
-		pAviParams->CropLeft , pAviParams->CropRight , pAviParams->CropTop , pAviParams->CropBottom );
-	if ( SizeImage <= 0 )
-		goto png_error;
-	if ( SizeImage & 1 )
+	NeedLock = SDL_MUSTLOCK( pSurface );
+	if ( NeedLock )
+		SDL_LockSurface ( pSurface );
+
+	/* Points to the top left pixel after cropping borders */
+	pBitmapIn = (Uint8 *)pSurface->pixels
+			+ pSurface->pitch * pAviParams->CropTop
+			+ pAviParams->CropLeft * pFormat->BytesPerPixel;
+	pBitmapOut = pJob->Pixels;
+
+	for ( y=0 ; y<pAviParams->Height ; y++ )
 	{
-		SizeImage++;							/* add an extra '\0' byte to get an even size */
-		fputc ( '\0' , pAviParams->FileOut );				/* next chunk must be aligned on 16 bits boundary */
+		memcpy ( pBitmapOut , pBitmapIn , LineSize );
+		pBitmapIn += pSurface->pitch;
+		pBitmapOut += LineSize;
 	}
 
-	/* Update the size of the video chunk */
-	Avi_StoreU32 ( TempSize , SizeImage );
-	if ( fseek ( pAviParams->FileOut , ChunkPos+4 , SEEK_SET ) != 0 )
-		goto png_error;
-	if ( fwrite ( TempSize , sizeof ( TempSize ) , 1 , pAviParams->FileOut ) != 1 )
-		goto png_error;
+	if ( NeedLock )
+		SDL_UnlockSurface ( pSurface );
 
-	/* Go to the end of the video frame data */
-	if ( fseek ( pAviParams->FileOut , 0 , SEEK_END ) != 0 )
-		goto png_error;
-	return true;
+	pJob->Format = *pFormat;
+	if ( pFormat->palette )
+	{
+		pJob->Palette = *pFormat->palette;
+		if ( pJob->Palette.ncolors > 256 )
+			pJob->Palette.ncolors = 256;
+		memcpy ( pJob->Colors , pFormat->palette->colors , pJob->Palette.ncolors * sizeof ( SDL_Color ) );
+		pJob->Palette.colors = pJob->Colors;
+		pJob->Format.palette = &pJob->Palette;
+	}
 
-png_error:
-	perror ( "Avi_RecordVideoStream_PNG" );
-	Log_AlertDlg ( LOG_ERROR, "AVI recording : failed to write png frame" );
-	return false;
+	memset ( &pJob->Surface , 0 , sizeof ( pJob->Surface ) );
+	pJob->Surface.format = &pJob->Format;
+	pJob->Surface.w = pAviParams->Width;
+	pJob->Surface.h = pAviParams->Height;
+	pJob->Surface.pitch = LineSize;
+	pJob->Surface.pixels = pJob->Pixels;
+	return true;
 }
-#endif  /* HAVE_LIBPNG */
 
 
 
 bool	Avi_RecordVideoStream ( void )
 {
-	if ( AviParams.VideoCodec == AVI_RECORD_VIDEO_CODEC_BMP )
-	{
-		if ( Avi_RecordVideoStream_BMP ( &AviParams ) == false )
-		{
-			return false;
-		}
-	}
-#if HAVE_LIBPNG
-	else if ( AviParams.VideoCodec == AVI_RECORD_VIDEO_CODEC_PNG )
-	{
-		if ( Avi_RecordVideoStream_PNG ( &AviParams ) == false )
-		{
-			return false;
-		}
-	}
-#endif
-	else
+	AVI_JOB		*pJob;
+
+	if ( !Avi_CheckWriteError ( &AviParams ) )
+		return false;
+
+	pJob = Avi_GetFreeJob ( &AviParams );
+	if ( !Avi_CopyVideoFrame ( &AviParams , pJob ) )
 	{
+		SDL_SemPost ( AviParams.JobsFree );				/* job was not used */
+		Log_AlertDlg ( LOG_ERROR, "AVI recording : failed to copy video frame" );
 		return false;
 	}
+	pJob->Type = AVI_JOB_VIDEO;
+	Avi_QueueJob ( &AviParams );
 
 	if (++AviParams.TotalVideoFrames % ( AviParams.Fps / AviParams.Fps_scale ) == 0)
 	{
@@ -515,37 +673,24 @@ bool	Avi_RecordVideoStream ( void )
 
 
 
-static bool	Avi_RecordAudioStream_PCM ( RECORD_AVI_PARAMS *pAviParams , Sint16 pSamples[][2] , int SampleIndex , int SampleLength )
+static bool	Avi_RecordAudioStream_PCM ( RECORD_AVI_PARAMS *pAviParams , AVI_JOB *pJob , Sint16 pSamples[][2] , int SampleIndex , int SampleLength )
 {
-	AVI_CHUNK	Chunk;
-	Sint16		sample[2];
+	Sint16		*pOut;
 	int		i;
 
-	/* Write the audio frame header */
-	Avi_Store4cc ( Chunk.ChunkName , "01wb" );				/* stream 1, wave bytes */
-	Avi_StoreU32 ( Chunk.ChunkSize , SampleLength * 4 );			/* 16 bits, stereo -> 4 bytes */
-	if ( fwrite ( &Chunk , sizeof ( Chunk ) , 1 , pAviParams->FileOut ) != 1 )
-	{
-		perror ( "Avi_RecordAudioStream_PCM" );
-		Log_AlertDlg ( LOG_ERROR, "AVI recording : failed to write pcm frame header" );
+	if ( !Avi_GrowBuffer ( &pJob->Data , &pJob->DataAlloc , SampleLength * 4 ) )	/* 16 bits, stereo -> 4 bytes */
 		return false;
-	}
 
-	/* Write the audio frame data */
+	pOut = (Sint16 *)pJob->Data;
 	for ( i = 0 ; i < SampleLength; i++ )
 	{
 		/* Convert sample to little endian */
-		sample[0] = SDL_SwapLE16 ( pSamples[ (SampleIndex+i) % MIXBUFFER_SIZE ][0]);
-		sample[1] = SDL_SwapLE16 ( pSamples[ (SampleIndex+i) % MIXBUFFER_SIZE ][1]);
-		/* And store */
-		if ( fwrite ( &sample , sizeof ( sample ) , 1 , pAviParams->FileOut ) != 1 )
-		{
-			perror ( "Avi_RecordAudioStream_PCM" );
-			Log_AlertDlg ( LOG_ERROR, "AVI recording : failed to write pcm frame" );
-			return false;
-		}
+		*pOut++ = SDL_SwapLE16 ( pSamples[ (SampleIndex+i) % MIXBUFFER_SIZE ][0]);
+		*pOut++ = SDL_SwapLE16 ( pSamples[ (SampleIndex+i) % MIXBUFFER_SIZE ][1]);
 	}
 
+	pJob->ChunkName = "01wb";						/* stream 1, wave bytes */
+	pJob->DataSize = SampleLength * 4;
 	return true;
 }
 
@@ -553,23 +698,295 @@ static bool	Avi_RecordAudioStream_PCM ( RECORD_AVI_PARAMS *pAviParams , Sint16 p
 
 bool	Avi_RecordAudioStream ( Sint16 pSamples[][2] , int SampleIndex , int SampleLength )
 {
-	if ( AviParams.AudioCodec == AVI_RECORD_AUDIO_CODEC_PCM )
+	AVI_JOB		*pJob;
+
+	if ( !Avi_CheckWriteError ( &AviParams ) )
+		return false;
+
+	if ( AviParams.AudioCodec != AVI_RECORD_AUDIO_CODEC_PCM )
+		return false;
+
+	/* Samples don't need to be compressed, they're stored directly in the job */
+	pJob = Avi_GetFreeJob ( &AviParams );
+	if ( !Avi_RecordAudioStream_PCM ( &AviParams , pJob , pSamples , SampleIndex , SampleLength ) )
 	{
-		if ( Avi_RecordAudioStream_PCM ( &AviParams , pSamples , SampleIndex , SampleLength ) == false )
+		SDL_SemPost ( AviParams.JobsFree );				/* job was not used */
+		Log_AlertDlg ( LOG_ERROR, "AVI recording : failed to copy pcm frame" );
+		return false;
+	}
+	pJob->Type = AVI_JOB_AUDIO;
+	Avi_QueueJob ( &AviParams );
+
+	AviParams.TotalAudioSamples += SampleLength;
+	return true;
+}
+
+
+
+/*-----------------------------------------------------------------------*/
+/**
+ * Return the next job to fill. If all jobs are still waiting to be encoded
+ * or written, this waits until the writer thread releases one.
+ */
+static AVI_JOB	*Avi_GetFreeJob ( RECORD_AVI_PARAMS *pAviParams )
+{
+	SDL_SemWait ( pAviParams->JobsFree );
+	return &pAviParams->Jobs[ pAviParams->JobsQueued % AVI_RECORD_JOBS ];
+}
+
+
+/**
+ * Pass the job returned by Avi_GetFreeJob() to the encoding threads
+ */
+static void	Avi_QueueJob ( RECORD_AVI_PARAMS *pAviParams )
+{
+	pAviParams->JobsQueued++;
+	SDL_SemPost ( pAviParams->JobsReady );
+}
+
+
+/**
+ * Report (only once) an error from the writer/encoding threads.
+ * Return false if an error happened.
+ */
+static bool	Avi_CheckWriteError ( RECORD_AVI_PARAMS *pAviParams )
+{
+	if ( !pAviParams->WriteError )
+		return true;
+
+	if ( !pAviParams->WriteErrorReported )
+	{
+		Log_AlertDlg ( LOG_ERROR, "AVI recording : failed to write frame" );
+		pAviParams->WriteErrorReported = true;
+	}
+	return false;
+}
+
+
+
+/*-----------------------------------------------------------------------*/
+/**
+ * Encoding thread : take the next queued job and compress it.
+ * Several encoding threads can run at the same time, each one on a different job.
+ */
+static int	Avi_EncoderThread ( void *pData )
+{
+	RECORD_AVI_PARAMS	*pAviParams = pData;
+	AVI_JOB			*pJob;
+	bool			ret;
+
+	for ( ;; )
+	{
+		SDL_SemWait ( pAviParams->JobsReady );
+		if ( pAviParams->ThreadsQuit )
+			break;
+
+		SDL_LockMutex ( pAviParams->JobsLock );
+		pJob = &pAviParams->Jobs[ pAviParams->JobsTaken++ % AVI_RECORD_JOBS ];
+		SDL_UnlockMutex ( pAviParams->JobsLock );
+
+		ret = true;
+		if ( pJob->Type == AVI_JOB_VIDEO )
 		{
-			return false;
+			if ( pAviParams->VideoCodec == AVI_RECORD_VIDEO_CODEC_BMP )
+				ret = Avi_EncodeVideoFrame_BMP ( pAviParams , pJob );
+#if HAVE_LIBPNG
+			else if ( pAviParams->VideoCodec == AVI_RECORD_VIDEO_CODEC_PNG )
+				ret = Avi_EncodeVideoFrame_PNG ( pAviParams , pJob );
+#endif
+			else if ( pAviParams->VideoCodec == AVI_RECORD_VIDEO_CODEC_ZLIB )
+				ret = Avi_EncodeVideoFrame_ZLIB ( pAviParams , pJob );
+			else
+				ret = false;
 		}
+		pJob->Error = !ret;
+
+		SDL_SemPost ( pJob->Encoded );
 	}
-	else
+
+	return 0;
+}
+
+
+
+/*-----------------------------------------------------------------------*/
+/**
+ * Writer thread : write one encoded job as a data chunk in the 'movi' list
+ * and keep its index entry for the 'idx1' chunk.
+ */
+static bool	Avi_WriteChunk ( RECORD_AVI_PARAMS *pAviParams , AVI_JOB *pJob )
+{
+	AVI_CHUNK	Chunk;
+	AVI_CHUNK_INDEX	*pIndex;
+	int		NewAlloc;
+
+	Avi_Store4cc ( Chunk.ChunkName , pJob->ChunkName );
+	Avi_StoreU32 ( Chunk.ChunkSize , pJob->DataSize );
+	if ( fwrite ( &Chunk , sizeof ( Chunk ) , 1 , pAviParams->FileOut ) != 1 )
+		return false;
+	if ( pJob->DataSize > 0 && fwrite ( pJob->Data , pJob->DataSize , 1 , pAviParams->FileOut ) != 1 )
+		return false;
+	if ( ( pJob->DataSize & 1 ) && fputc ( '\0' , pAviParams->FileOut ) == EOF )
+		return false;							/* next chunk must be aligned on 16 bits boundary */
+
+	if ( pAviParams->IndexCount == pAviParams->IndexAlloc )
+	{
+		NewAlloc = pAviParams->IndexAlloc ? pAviParams->IndexAlloc * 2 : 4096;
+		pIndex = realloc ( pAviParams->Index , NewAlloc * sizeof ( AVI_CHUNK_INDEX ) );
+		if ( !pIndex )
+			return false;
+		pAviParams->Index = pIndex;
+		pAviParams->IndexAlloc = NewAlloc;
+	}
+
+	pIndex = &pAviParams->Index[ pAviParams->IndexCount++ ];
+	Avi_Store4cc ( pIndex->identifier , pJob->ChunkName );			/* 00dc, 00db, 01wb, ... */
+	Avi_StoreU32 ( pIndex->flags , AVIIF_KEYFRAME );
+	Avi_StoreU32 ( pIndex->offset , pAviParams->MoviPos );			/* pos relative to 'movi' */
+	Avi_StoreU32 ( pIndex->length , pJob->DataSize );
+
+	pAviParams->MoviPos += sizeof ( Chunk ) + ( ( pJob->DataSize + 1 ) & ~1 );
+	return true;
+}
+
+
+/**
+ * Writer thread : write the jobs in the order they were queued, as soon as
+ * they're encoded, then make them available again to the emulation thread.
+ */
+static int	Avi_WriterThread ( void *pData )
+{
+	RECORD_AVI_PARAMS	*pAviParams = pData;
+	AVI_JOB			*pJob;
+	Uint32			JobNb;
+
+	for ( JobNb = 0 ; ; JobNb++ )
 	{
+		pJob = &pAviParams->Jobs[ JobNb % AVI_RECORD_JOBS ];
+		SDL_SemWait ( pJob->Encoded );
+		if ( pJob->Type == AVI_JOB_END )
+			break;
+
+		/* After an error, jobs are still released but nothing more is written */
+		if ( !pAviParams->WriteError && ( pJob->Error || !Avi_WriteChunk ( pAviParams , pJob ) ) )
+		{
+			perror ( "Avi_WriterThread" );
+			pAviParams->WriteError = true;
+		}
+
+		SDL_SemPost ( pAviParams->JobsFree );
+	}
+
+	return 0;
+}
+
+
+
+/*-----------------------------------------------------------------------*/
+/**
+ * Create the encoding and writer threads, return false on error
+ */
+static bool	Avi_StartThreads ( RECORD_AVI_PARAMS *pAviParams )
+{
+	int	i;
+
+	pAviParams->MoviPos = 4;						/* first chunk is just after 'movi' */
+
+	pAviParams->JobsFree = SDL_CreateSemaphore ( AVI_RECORD_JOBS );
+	pAviParams->JobsReady = SDL_CreateSemaphore ( 0 );
+	pAviParams->JobsLock = SDL_CreateMutex ();
+	if ( !pAviParams->JobsFree || !pAviParams->JobsReady || !pAviParams->JobsLock )
 		return false;
+
+	for ( i = 0 ; i < AVI_RECORD_JOBS ; i++ )
+	{
+		pAviParams->Jobs[ i ].Encoded = SDL_CreateSemaphore ( 0 );
+		if ( !pAviParams->Jobs[ i ].Encoded )
+			return false;
 	}
 
-	AviParams.TotalAudioSamples += SampleLength;
+	for ( i = 0 ; i < AVI_RECORD_ENCODERS ; i++ )
+	{
+#if WITH_SDL2
+		pAviParams->EncoderThreads[ i ] = SDL_CreateThread ( Avi_EncoderThread , "aviencoder" , pAviParams );
+#else
+		pAviParams->EncoderThreads[ i ] = SDL_CreateThread ( Avi_EncoderThread , pAviParams );
+#endif
+		if ( !pAviParams->EncoderThreads[ i ] )
+			return false;
+	}
+
+#if WITH_SDL2
+	pAviParams->WriterThread = SDL_CreateThread ( Avi_WriterThread , "aviwriter" , pAviParams );
+#else
+	pAviParams->WriterThread = SDL_CreateThread ( Avi_WriterThread , pAviParams );
+#endif
+	if ( !pAviParams->WriterThread )
+		return false;
+
 	return true;
 }
 
 
+/**
+ * Wait until all the queued jobs are written, then stop the threads
+ * and free the jobs. Also used to clean up after Avi_StartThreads() failed.
+ */
+static void	Avi_StopThreads ( RECORD_AVI_PARAMS *pAviParams )
+{
+	AVI_JOB	*pJob;
+	int	i;
+
+	if ( pAviParams->WriterThread )
+	{
+		pJob = Avi_GetFreeJob ( pAviParams );
+		pJob->Type = AVI_JOB_END;
+		Avi_QueueJob ( pAviParams );
+		SDL_WaitThread ( pAviParams->WriterThread , NULL );
+		pAviParams->WriterThread = NULL;
+	}
+
+	/* No job left, wake up the encoders so they can quit */
+	pAviParams->ThreadsQuit = true;
+	for ( i = 0 ; i < AVI_RECORD_ENCODERS ; i++ )
+		if ( pAviParams->EncoderThreads[ i ] )
+			SDL_SemPost ( pAviParams->JobsReady );
+	for ( i = 0 ; i < AVI_RECORD_ENCODERS ; i++ )
+		if ( pAviParams->EncoderThreads[ i ] )
+		{
+			SDL_WaitThread ( pAviParams->EncoderThreads[ i ] , NULL );
+			pAviParams->EncoderThreads[ i ] = NULL;
+		}
+
+	for ( i = 0 ; i < AVI_RECORD_JOBS ; i++ )
+	{
+		pJob = &pAviParams->Jobs[ i ];
+		if ( pJob->ZStreamInit )
+			deflateEnd ( &pJob->ZStream );
+		pJob->ZStreamInit = false;
+		free ( pJob->Pixels );
+		pJob->Pixels = NULL;
+		pJob->PixelsAlloc = 0;
+		free ( pJob->Data );
+		pJob->Data = NULL;
+		pJob->DataAlloc = 0;
+		if ( pJob->Encoded )
+			SDL_DestroySemaphore ( pJob->Encoded );
+		pJob->Encoded = NULL;
+	}
+
+	if ( pAviParams->JobsLock )
+		SDL_DestroyMutex ( pAviParams->JobsLock );
+	if ( pAviParams->JobsReady )
+		SDL_DestroySemaphore ( pAviParams->JobsReady );
+	if ( pAviParams->JobsFree )
+		SDL_DestroySemaphore ( pAviParams->JobsFree );
+	pAviParams->JobsLock = NULL;
+	pAviParams->JobsReady = NULL;
+	pAviParams->JobsFree = NULL;
+}
+
+
 
 
 static void	Avi_BuildFileHeader ( RECORD_AVI_PARAMS *pAviParams , AVI_FILE_HEADER *pAviFileHeader )
@@ -591,6 +1008,8 @@ static void	Avi_BuildFileHeader ( RECORD_AVI_PARAMS *pAviParams , AVI_FILE_HEADE
 		SizeImage = Avi_GetBmpSize ( Width , Height , BitCount );		/* size of a BMP image */
 	else if ( pAviParams->VideoCodec == AVI_RECORD_VIDEO_CODEC_PNG )
 		SizeImage = Avi_GetBmpSize ( Width , Height , BitCount );		/* max size of a PNG image */
+	else if ( pAviParams->VideoCodec == AVI_RECORD_VIDEO_CODEC_ZLIB )
+		SizeImage = Avi_GetBmpSize ( Width , Height , BitCount );		/* max size of a zlib image */
 
 
 	/* RIFF / AVI headers */
@@ -633,6 +1052,8 @@ static void	Avi_BuildFileHeader ( RECORD_AVI_PARAMS *pAviParams , AVI_FILE_HEADE
 		Avi_StoreU32 ( pAviFileHeader->VideoStream.Header.stream_handler , VIDEO_STREAM_RGB );
 	else if ( pAviParams->VideoCodec == AVI_RECORD_VIDEO_CODEC_PNG )
 		Avi_Store4cc ( pAviFileHeader->VideoStream.Header.stream_handler , VIDEO_STREAM_PNG );
+	else if ( pAviParams->VideoCodec == AVI_RECORD_VIDEO_CODEC_ZLIB )
+		Avi_Store4cc ( pAviFileHeader->VideoStream.Header.stream_handler , VIDEO_STREAM_ZLIB );
 	Avi_StoreU32 ( pAviFileHeader->VideoStream.Header.flags , 0 );
 	Avi_StoreU16 ( pAviFileHeader->VideoStream.Header.priority , 0 );
 	Avi_StoreU16 ( pAviFileHeader->VideoStream.Header.language , 0 );
@@ -649,11 +1070,20 @@ static void	Avi_BuildFileHeader ( RECORD_AVI_PARAMS *pAviParams , AVI_FILE_HEADE
 	Avi_StoreU16 ( pAviFileHeader->VideoStream.Header.dest_right , Width );
 	Avi_StoreU16 ( pAviFileHeader->VideoStream.Header.dest_bottom , Height );
 
+	/* Only 'ZLIB' needs extra data after the bitmap header, for the other */
+	/* codecs these 8 bytes are turned into an empty 'JUNK' chunk */
 	Avi_Store4cc ( pAviFileHeader->VideoStream.Format.ChunkName , "strf" );
-	Avi_StoreU32 ( pAviFileHeader->VideoStream.Format.ChunkSize , sizeof ( AVI_STREAM_FORMAT_VIDS ) - 8 );
+	if ( pAviParams->VideoCodec == AVI_RECORD_VIDEO_CODEC_ZLIB )
+		Avi_StoreU32 ( pAviFileHeader->VideoStream.Format.ChunkSize , sizeof ( AVI_STREAM_FORMAT_VIDS ) - 8 );
+	else
+	{
+		Avi_StoreU32 ( pAviFileHeader->VideoStream.Format.ChunkSize , sizeof ( AVI_STREAM_FORMAT_VIDS ) - 8 - 8 );
+		Avi_Store4cc ( pAviFileHeader->VideoStream.Format.extra_data , "JUNK" );
+		Avi_StoreU32 ( pAviFileHeader->VideoStream.Format.extra_data+4 , 0 );
+	}
 	if ( pAviParams->VideoCodec == AVI_RECORD_VIDEO_CODEC_BMP )
 	{
-		Avi_StoreU32 ( pAviFileHeader->VideoStream.Format.size , sizeof ( AVI_STREAM_FORMAT_VIDS ) - 8 );
+		Avi_StoreU32 ( pAviFileHeader->VideoStream.Format.size , sizeof ( AVI_STREAM_FORMAT_VIDS ) - 8 - 8 );
 		Avi_StoreU32 ( pAviFileHeader->VideoStream.Format.width , Width );
 		Avi_StoreU32 ( pAviFileHeader->VideoStream.Format.height , Height );
 		Avi_StoreU16 ( pAviFileHeader->VideoStream.Format.planes , 1 );			/* always 1 */
@@ -679,6 +1109,25 @@ static void	Avi_BuildFileHeader ( RECORD_AVI_PARAMS *pAviParams , AVI_FILE_HEADE
 		Avi_StoreU32 ( pAviFileHeader->VideoStream.Format.clr_used , 0 );		/* no color map */
 		Avi_StoreU32 ( pAviFileHeader->VideoStream.Format.clr_important , 0 );		/* no color map */
 	}
+	else if ( pAviParams->VideoCodec == AVI_RECORD_VIDEO_CODEC_ZLIB )
+	{
+		Avi_StoreU32 ( pAviFileHeader->VideoStream.Format.size , sizeof ( AVI_STREAM_FORMAT_VIDS ) - 8 );
+		Avi_StoreU32 ( pAviFileHeader->VideoStream.Format.width , Width );
+		Avi_StoreU32 ( pAviFileHeader->VideoStream.Format.height , Height );
+		Avi_StoreU16 ( pAviFileHeader->VideoStream.Format.planes , 1 );			/* always 1 */
+		Avi_StoreU16 ( pAviFileHeader->VideoStream.Format.bit_count , BitCount );
+		Avi_Store4cc ( pAviFileHeader->VideoStream.Format.compression , VIDEO_STREAM_ZLIB );
+		Avi_StoreU32 ( pAviFileHeader->VideoStream.Format.size_image , SizeImage );	/* max size if uncompressed */
+		Avi_StoreU32 ( pAviFileHeader->VideoStream.Format.xpels_meter , 0 );
+		Avi_StoreU32 ( pAviFileHeader->VideoStream.Format.ypels_meter , 0 );
+		Avi_StoreU32 ( pAviFileHeader->VideoStream.Format.clr_used , 0 );		/* no color map */
+		Avi_StoreU32 ( pAviFileHeader->VideoStream.Format.clr_important , 0 );		/* no color map */
+		Avi_StoreU32 ( pAviFileHeader->VideoStream.Format.extra_data , 4 );
+		pAviFileHeader->VideoStream.Format.extra_data[4] = VIDEO_STREAM_ZLIB_IMGTYPE_RGB24;
+		pAviFileHeader->VideoStream.Format.extra_data[5] = pAviParams->VideoCodecCompressionLevel;
+		pAviFileHeader->VideoStream.Format.extra_data[6] = 0;			/* no flags */
+		pAviFileHeader->VideoStream.Format.extra_data[7] = VIDEO_STREAM_ZLIB_CODEC;
+	}
 
 
 	/* Audio Stream */
@@ -724,56 +1173,18 @@ static void	Avi_BuildFileHeader ( RECORD_AVI_PARAMS *pAviParams , AVI_FILE_HEADE
 static bool	Avi_BuildIndex ( RECORD_AVI_PARAMS *pAviParams )
 {
 	AVI_CHUNK	Chunk;
-	long		IndexChunkPosStart;
-	long		Pos , PosWrite;
-	Uint8		TempSize[4];
-	AVI_CHUNK_INDEX	ChunkIndex;
-	Uint32		Size;
 
 	fseek ( pAviParams->FileOut , 0 , SEEK_END );				/* go to the end of the file */
 
-	/* Write the 'idx1' chunk header */
-	IndexChunkPosStart = ftell ( pAviParams->FileOut );
-	Avi_Store4cc ( Chunk.ChunkName , "idx1" );				/* stream 0, uncompressed DIB bytes */
-	Avi_StoreU32 ( Chunk.ChunkSize , 0 );					/* index size (-> completed later) */
+	/* The index entries were stored by the writer thread for each data chunk, */
+	/* so there's no need to read the 'movi' chunk back */
+	Avi_Store4cc ( Chunk.ChunkName , "idx1" );
+	Avi_StoreU32 ( Chunk.ChunkSize , pAviParams->IndexCount * sizeof ( AVI_CHUNK_INDEX ) );
 	if ( fwrite ( &Chunk , sizeof ( Chunk ) , 1 , pAviParams->FileOut ) != 1 )
 		goto index_error;
-	PosWrite = ftell ( pAviParams->FileOut );				/* position to start writing indexes */
-
-	/* Go to the first data chunk in the 'movi' chunk */
-	fseek ( pAviParams->FileOut , pAviParams->MoviChunkPosStart + sizeof ( AVI_STREAM_LIST_MOVI ) , SEEK_SET );
-	Pos = ftell ( pAviParams->FileOut );
-
-	/* Build the index : we seek/read one data chunk and seek/write the */
-	/* corresponding infos at the end of the index, until we reach the */
-	/* end of the 'movi' chunk. */
-	while ( Pos < pAviParams->MoviChunkPosEnd )
-	{
-		/* Read the header for this data chunk: ChunkName and ChunkSize */
-		if (fread(&Chunk, sizeof(Chunk), 1, pAviParams->FileOut) != 1)
-			goto index_error;
-		Size = Avi_ReadU32 ( Chunk.ChunkSize );
-
-		/* Write the index infos for this chunk */
-		fseek ( pAviParams->FileOut , PosWrite , SEEK_SET );
-		Avi_Store4cc ( ChunkIndex.identifier , (char *)Chunk.ChunkName );	/* 00dc, 00db, 01wb, ... */
-		Avi_StoreU32 ( ChunkIndex.flags , AVIIF_KEYFRAME );		/* AVIIF_KEYFRAME */
-		Avi_StoreU32 ( ChunkIndex.offset , Pos - pAviParams->MoviChunkPosStart - 8  );	/* pos relative to 'movi' */
-		Avi_StoreU32 ( ChunkIndex.length , Size );
-		if (fwrite ( &ChunkIndex , sizeof ( ChunkIndex ) , 1 , pAviParams->FileOut ) != 1)
-			goto index_error;
-		PosWrite = ftell ( pAviParams->FileOut );			/* position for the next index */
-
-		/* Go to the next data chunk in the 'movi' chunk */
-		Pos = Pos + sizeof ( Chunk ) + Size;				/* position of the next data chunk */
-		fseek ( pAviParams->FileOut , Pos , SEEK_SET );
-	}
-
-	/* Update the size of the 'idx1' chunk */
-	Avi_StoreU32 ( TempSize , PosWrite - IndexChunkPosStart - 8 );
-	if ( fseek ( pAviParams->FileOut , IndexChunkPosStart+4 , SEEK_SET ) != 0 )
-		goto index_error;
-	if ( fwrite ( TempSize , sizeof ( TempSize ) , 1 , pAviParams->FileOut ) != 1 )
+	if ( pAviParams->IndexCount > 0
+	  && fwrite ( pAviParams->Index , sizeof ( AVI_CHUNK_INDEX ) , pAviParams->IndexCount , pAviParams->FileOut )
+		!= (size_t)pAviParams->IndexCount )
 		goto index_error;
 	return true;
 
@@ -864,6 +1275,14 @@ static bool	Avi_StartRecording_WithParams ( RECORD_AVI_PARAMS *pAviParams , char
 		return false;
 	}
 
+	/* Start the encoding and writer threads */
+	if ( !Avi_StartThreads ( pAviParams ) )
+	{
+		Avi_StopThreads ( pAviParams );
+		fclose ( pAviParams->FileOut );
+		Log_AlertDlg ( LOG_ERROR, "AVI recording : failed to start encoding threads" );
+		return false;
+	}
 
 	/* We're ok to record */
 	Log_AlertDlg ( LOG_INFO, "AVI recording has been started");
@@ -878,11 +1297,16 @@ static bool	Avi_StopRecording_WithParams ( RECORD_AVI_PARAMS *pAviParams )
 {
 	long	FileSize;
 	Uint8	TempSize[4];
+	bool	IndexOk;
 
 
 	if ( bRecordingAvi == false )						/* no recording ? */
 		return true;
 
+	/* Write all the pending frames */
+	Avi_StopThreads ( pAviParams );
+	Avi_CheckWriteError ( pAviParams );
+
 	/* Update the size of the 'movi' chunk */
 	fseek ( pAviParams->FileOut , 0 , SEEK_END );				/* go to the end of the 'movi' chunk */
 	pAviParams->MoviChunkPosEnd = ftell ( pAviParams->FileOut );
@@ -902,7 +1326,10 @@ static bool	Avi_StopRecording_WithParams ( RECORD_AVI_PARAMS *pAviParams )
 	}
 
 	/* Build the index chunk */
-	if ( ! Avi_BuildIndex ( pAviParams ) )
+	IndexOk = Avi_BuildIndex ( pAviParams );
+	free ( pAviParams->Index );
+	pAviParams->Index = NULL;
+	if ( ! IndexOk )
 	{
 		perror ( "AviStopRecording" );
 		Log_AlertDlg ( LOG_ERROR, "AVI recording : failed to build index" );
@@ -960,7 +1387,10 @@ bool	Avi_StartRecording ( char *FileName , bool CropGui , Uint32 Fps , Uint32 Fp
 	memset ( &AviParams , 0 , sizeof ( AviParams ) );
 
 	AviParams.VideoCodec = VideoCodec;
-	AviParams.VideoCodecCompressionLevel = 9;	/* png compression level */
+	if ( VideoCodec == AVI_RECORD_VIDEO_CODEC_ZLIB )
+		AviParams.VideoCodecCompressionLevel = Z_BEST_SPEED;	/* zlib compression level */
+	else
+		AviParams.VideoCodecCompressionLevel = 9;	/* png compression level */
 	AviParams.AudioCodec = AVI_RECORD_AUDIO_CODEC_PCM;
 	AviParams.AudioFreq = ConfigureParams.Sound.nPlaybackFreq;
 	AviParams.Surface = sdlscrn;
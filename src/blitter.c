@@ -29,6 +29,7 @@ const char Blitter_fileid[] = "Hatari blitter.c : " __DATE__ " " __TIME__;
 #include <SDL_types.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "main.h"
 #include "blitter.h"
@@ -117,12 +118,22 @@ typedef struct
 	Uint8	nfsr;
 } BLITTERSTATE;
 
+/* Blitter fast path vars, set up for each pass */
+typedef struct
+{
+	bool	enabled;
+	bool	use_src;
+	bool	use_dst;
+	bool	copy;
+} BLITTERFAST;
+
 /* Blitter logical op func */
 typedef Uint16 (*BLITTER_OP_FUNC)(void);
 
 static BLITTERREGS	BlitterRegs;
 static BLITTERVARS	BlitterVars;
 static BLITTERSTATE	BlitterState;
+static BLITTERFAST	BlitterFast;
 static Uint16		BlitterHalftone[16];
 
 static BLITTER_OP_FUNC Blitter_ComputeHOP;
@@ -503,6 +514,212 @@ static void Blitter_Step(void)
 	}
 }
 
+/*-----------------------------------------------------------------------*/
+/**
+ * Blitter emulation - fast path
+ *
+ * Without skew, smudge or extra source reads, each word of a line only
+ * depends on one source word and one destination word, so runs of words
+ * in ST RAM can be processed at once, up to the end of the line. A run
+ * stops at the word after which an interrupt occurs or the bus is given
+ * back to the CPU, so that these still happen at the same word as with
+ * the word by word emulation above.
+ */
+
+/* LOPs using the result of the HOP (all except 0, 5, A and F) */
+#define BLITTER_LOP_USES_HOP	0x7BDE
+/* LOPs using the destination word (all except 0, 3, C and F) */
+#define BLITTER_LOP_USES_DST	0x6FF6
+
+/* Lowest address written by the blitter without supervisor check */
+#define BLITTER_FAST_RAM_START	0x800
+
+static void Blitter_FastSetup(void)
+{
+	bool use_hop = (BLITTER_LOP_USES_HOP >> BlitterRegs.lop) & 1;
+
+	BlitterFast.use_src = use_hop && BlitterRegs.hop >= 2;
+	BlitterFast.use_dst = (BLITTER_LOP_USES_DST >> BlitterRegs.lop) & 1;
+	BlitterFast.copy = BlitterRegs.hop == 2 && BlitterRegs.lop == 3;
+
+	/* With a negative source increment and no skew, the source word is
+	 * the one fetched before, so keep it on the word by word path */
+	BlitterFast.enabled = BlitterVars.skew == 0 && !BlitterVars.fxsr
+		&& !BlitterVars.nfsr && !BlitterVars.smudge
+		&& (!BlitterFast.use_src || BlitterRegs.src_x_incr >= 0);
+}
+
+static bool Blitter_FastInRam(Uint32 addr, Uint32 words, short incr)
+{
+	Sint64 first = addr;
+	Sint64 last = first + (Sint64)(words - 1) * incr;
+
+	if (last < first)
+	{
+		Sint64 tmp = first;
+		first = last;
+		last = tmp;
+	}
+
+	return first >= BLITTER_FAST_RAM_START && last + 2 <= STRamEnd;
+}
+
+static inline int Blitter_FastWordCycles(Uint16 end_mask)
+{
+	return 4 * (1 + BlitterFast.use_src + (BlitterFast.use_dst || end_mask != 0xFFFF));
+}
+
+static inline Uint16 Blitter_FastLOP(Uint16 hop, Uint16 dst)
+{
+	switch (BlitterRegs.lop)
+	{
+	 case 0x0:	return 0;
+	 case 0x1:	return hop & dst;
+	 case 0x2:	return hop & ~dst;
+	 case 0x3:	return hop;
+	 case 0x4:	return ~hop & dst;
+	 case 0x5:	return dst;
+	 case 0x6:	return hop ^ dst;
+	 case 0x7:	return hop | dst;
+	 case 0x8:	return ~hop & ~dst;
+	 case 0x9:	return ~hop ^ dst;
+	 case 0xA:	return ~dst;
+	 case 0xB:	return hop | ~dst;
+	 case 0xC:	return ~hop;
+	 case 0xD:	return ~hop | dst;
+	 case 0xE:	return ~hop | ~dst;
+	 default:	return 0xFFFF;
+	}
+}
+
+static inline void Blitter_FastWord(Uint32 src_addr, Uint32 dst_addr,
+                                    Uint16 halftone, Uint16 end_mask)
+{
+	Uint16 hop = halftone;
+	Uint16 dst = 0, result;
+
+	if (BlitterFast.use_src)
+	{
+		Uint16 src = STMemory_ReadWord(src_addr);
+		BlitterVars.buffer = (BlitterVars.buffer << 16) | src;
+		hop = (BlitterRegs.hop == 2) ? src : (src & halftone);
+	}
+	if (BlitterFast.use_dst || end_mask != 0xFFFF)
+		dst = STMemory_ReadWord(dst_addr);
+
+	result = Blitter_FastLOP(hop, dst);
+	STMemory_WriteWord(dst_addr, (result & end_mask) | (dst & ~end_mask));
+}
+
+static inline Uint16 Blitter_FastEndMask(Uint32 pos)
+{
+	if (pos == 0)
+		return BlitterRegs.end_mask_1;
+	else if (pos == BlitterVars.dst_words_reset - 1)
+		return BlitterRegs.end_mask_3;
+	return BlitterRegs.end_mask_2;
+}
+
+static bool Blitter_FastWords(void)
+{
+	Uint32 words_left = BlitterRegs.words;
+	Uint32 pos = BlitterVars.dst_words_reset - words_left;
+	Uint32 src_addr = BlitterRegs.src_addr;
+	Uint32 dst_addr = BlitterRegs.dst_addr;
+	short src_x_incr = BlitterRegs.src_x_incr;
+	short dst_x_incr = BlitterRegs.dst_x_incr;
+	bool end_of_line;
+	Uint16 halftone;
+	int cycles = 0;
+	Uint32 n = 0, i;
+
+	if (!BlitterFast.enabled || nWaitStateCycles)
+		return false;
+
+	/* Take the words until the end of the line, as long as the bus is
+	 * not given back to the CPU and no interrupt occurs before the last
+	 * one (the interrupt handlers are called after it, when flushing) */
+	while (n < words_left)
+	{
+		if (!BlitterVars.hog && BlitterVars.pass_cycles + cycles >= NONHOG_CYCLES)
+			break;
+		if (INT_CONVERT_TO_INTERNAL((Sint64)cycles, INT_CPU_CYCLE) >= PendingInterruptCount)
+			break;
+		cycles += Blitter_FastWordCycles(Blitter_FastEndMask(pos + n));
+		n++;
+	}
+
+	if (n == 0 || !Blitter_FastInRam(dst_addr, n, dst_x_incr)
+	    || (BlitterFast.use_src && !Blitter_FastInRam(src_addr, n, src_x_incr)))
+		return false;
+
+	if (pos == 0)
+		Blitter_BeginLine();
+
+	halftone = (BlitterRegs.hop & 1) ? BlitterHalftone[BlitterVars.line] : 0xFFFF;
+	end_of_line = (n == words_left);
+
+	i = 0;
+	if (pos == 0)
+	{
+		Blitter_FastWord(src_addr, dst_addr, halftone, BlitterRegs.end_mask_1);
+		i++;
+	}
+
+	/* Middle words of a plain copy */
+	if (BlitterFast.copy && BlitterRegs.end_mask_2 == 0xFFFF
+	    && src_x_incr == 2 && dst_x_incr == 2)
+	{
+		Uint32 middle = n - i - (end_of_line && n > i ? 1 : 0);
+		Uint32 src_middle = src_addr + i * 2;
+		Uint32 dst_middle = dst_addr + i * 2;
+
+		if (middle > 1 && (src_middle + middle * 2 <= dst_middle
+		                   || dst_middle + middle * 2 <= src_middle))
+		{
+			memcpy(&STRam[dst_middle], &STRam[src_middle], middle * 2);
+			STMemory_SetDirtyArea(dst_middle, middle * 2);
+			BlitterVars.buffer = ((Uint32)STMemory_ReadWord(src_middle + (middle - 2) * 2) << 16)
+			                     | STMemory_ReadWord(src_middle + (middle - 1) * 2);
+			i += middle;
+		}
+	}
+
+	for ( ; i < n; i++)
+	{
+		Blitter_FastWord(src_addr + i * src_x_incr, dst_addr + i * dst_x_incr,
+		                 halftone, Blitter_FastEndMask(pos + i));
+	}
+
+	/* Update registers as the word by word emulation would do */
+	if (end_of_line)
+	{
+		if (BlitterFast.use_src)
+		{
+			BlitterRegs.src_addr = src_addr + (n - 1) * src_x_incr + BlitterRegs.src_y_incr;
+			BlitterVars.src_words = 1;
+		}
+		BlitterRegs.dst_addr = dst_addr + (n - 1) * dst_x_incr + BlitterRegs.dst_y_incr;
+	}
+	else
+	{
+		if (BlitterFast.use_src)
+		{
+			BlitterRegs.src_addr = src_addr + n * src_x_incr;
+			BlitterVars.src_words -= n;
+		}
+		BlitterRegs.dst_addr = dst_addr + n * dst_x_incr;
+		BlitterRegs.words -= n;
+	}
+
+	Blitter_AddCycles(cycles);
+
+	if (end_of_line)
+		Blitter_EndLine();
+
+	return true;
+}
+
 /*-----------------------------------------------------------------------*/
 /**
  * Let's do the blit.
@@ -515,6 +732,7 @@ static void Blitter_Start(void)
 	/* select HOP & LOP funcs */
 	Blitter_Select_HOP();
 	Blitter_Select_LOP();
+	Blitter_FastSetup();
 
 	/* setup vars */
 	BlitterVars.pass_cycles = 0;
@@ -529,7 +747,8 @@ static void Blitter_Start(void)
 	/* Now we enter the main blitting loop */
 	do
 	{
-		Blitter_Step();
+		if (!Blitter_FastWords())
+			Blitter_Step();
 		Blitter_FlushCycles();
 	}
 	while (BlitterRegs.lines > 0
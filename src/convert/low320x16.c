@@ -27,6 +27,12 @@ static void ConvertLowRes_320x16Bit(void)
 
 		update = AdjustLinePaletteRemap(y) & PALETTEMASK_UPDATEMASK;
 
+		if (!Convert_LineChanged(y, update))   /* Skip unchanged lines */
+		{
+			pPCScreenDest = (((Uint8 *)pPCScreenDest)+PCScreenBytesPerLine);
+			continue;
+		}
+
 		x = STScreenWidthBytes>>3; /* Amount to draw across in 16-pixels (8 bytes) */
 
 		do    /* x-loop */
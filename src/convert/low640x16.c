@@ -98,7 +98,7 @@ static void ConvertLowRes_640x16Bit(void)
 	Uint32 *edi, *ebp;
 	Uint32 *esi;
 	Uint32 eax;
-	int y;
+	int y, update;
 
 	Convert_StartFrame();            /* Start frame, track palettes */
 
@@ -111,10 +111,14 @@ static void ConvertLowRes_640x16Bit(void)
 		ebp = (Uint32 *)((Uint8 *)pSTScreenCopy + eax);    /* Previous ST format screen */
 		esi = (Uint32 *)pPCScreenDest;                     /* PC format screen */
 
-		if (AdjustLinePaletteRemap(y) & 0x00030000)        /* Change palette table */
-			Line_ConvertMediumRes_640x16Bit(edi, ebp, (Uint16 *)esi, eax);
-		else
-			Line_ConvertLowRes_640x16Bit(edi, ebp, esi, eax);
+		update = AdjustLinePaletteRemap(y);
+		if (Convert_LineChanged(y, update))                /* Skip unchanged lines */
+		{
+			if (update & 0x00030000)    /* Change palette table */
+				Line_ConvertMediumRes_640x16Bit(edi, ebp, (Uint16 *)esi, eax);
+			else
+				Line_ConvertLowRes_640x16Bit(edi, ebp, esi, eax);
+		}
 
 		pPCScreenDest = (((Uint8 *)pPCScreenDest)+PCScreenBytesPerLine*2);  /* Offset to next line */
 	}
@@ -12,7 +12,7 @@ static void ConvertMediumRes_640x32Bit(void)
 	Uint32 *edi, *ebp;
 	Uint32 *esi;
 	Uint32 eax;
-	int y;
+	int y, update;
 
 	Convert_StartFrame();            /* Start frame, track palettes */
 
@@ -24,10 +24,14 @@ static void ConvertMediumRes_640x32Bit(void)
 		ebp = (Uint32 *)((Uint8 *)pSTScreenCopy + eax);    /* Previous ST format screen */
 		esi = (Uint32 *)pPCScreenDest;                     /* PC format screen */
 
-		if (AdjustLinePaletteRemap(y) & 0x00030000)        /* Change palette table */
-			Line_ConvertMediumRes_640x32Bit(edi, ebp, esi, eax);
-		else
-			Line_ConvertLowRes_640x32Bit(edi, ebp, esi, eax);
+		update = AdjustLinePaletteRemap(y);
+		if (Convert_LineChanged(y, update))                /* Skip unchanged lines */
+		{
+			if (update & 0x00030000)    /* Change palette table */
+				Line_ConvertMediumRes_640x32Bit(edi, ebp, esi, eax);
+			else
+				Line_ConvertLowRes_640x32Bit(edi, ebp, esi, eax);
+		}
 
 		/* Offset to next line */
 		pPCScreenDest = (((Uint8 *)pPCScreenDest) + PCScreenBytesPerLine * 2);
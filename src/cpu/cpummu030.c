@@ -59,6 +59,12 @@ char table_letter[4] = {'A','B','C','D'};
 /* ATC struct */
 #define ATC030_NUM_ENTRIES  22
 
+/* Host side cache in front of the ATC, see mmu030_logical_is_in_atc() */
+#define ATC030_CACHE_BITS   12
+#define ATC030_CACHE_SIZE   (1<<ATC030_CACHE_BITS)
+#define ATC030_CACHE_INDEX(addr,fc) \
+    ((((addr)>>mmu030.translation.page.size)^((fc)<<(ATC030_CACHE_BITS-3)))&(ATC030_CACHE_SIZE-1))
+
 typedef struct {
     struct {
         uaecptr addr;
@@ -105,6 +111,12 @@ struct {
     
     /* Address translation cache */
     MMU030_ATC_LINE atc[ATC030_NUM_ENTRIES];
+    /* number of ATC entries with history bit set */
+    int atc_mru_count;
+    /* ATC entry last used for a page and function code. This is only
+     * a hint, the entry is checked before use, so it doesn't need to be
+     * kept in sync with single ATC entries getting flushed or replaced */
+    uae_u8 atc_cache[ATC030_CACHE_SIZE];
     
     /* Condition */
     bool enabled;
@@ -411,6 +423,7 @@ void mmu030_flush_atc_fc(uae_u32 fc_base, uae_u32 fc_mask) {
  * and their function code */
 void mmu030_flush_atc_page_fc(uaecptr logical_addr, uae_u32 fc_base, uae_u32 fc_mask) {
     int i;
+    logical_addr &= ~mmu030.translation.page.mask; /* entries hold page addresses */
     for (i=0; i<ATC030_NUM_ENTRIES; i++) {
         if (((fc_base&fc_mask)==(mmu030.atc[i].logical.fc&fc_mask)) &&
             (mmu030.atc[i].logical.addr == logical_addr) &&
@@ -424,6 +437,7 @@ void mmu030_flush_atc_page_fc(uaecptr logical_addr, uae_u32 fc_base, uae_u32 fc_
 /* This function flushes ATC entries depending on their logical address */
 void mmu030_flush_atc_page(uaecptr logical_addr) {
     int i;
+    logical_addr &= ~mmu030.translation.page.mask; /* entries hold page addresses */
     for (i=0; i<ATC030_NUM_ENTRIES; i++) {
         if ((mmu030.atc[i].logical.addr == logical_addr) &&
             mmu030.atc[i].logical.valid) {
@@ -442,6 +456,7 @@ void mmu030_flush_atc_all(void) {
     for (i=0; i<ATC030_NUM_ENTRIES; i++) {
         mmu030.atc[i].logical.valid = false;
     }
+    memset(mmu030.atc_cache, 0, sizeof(mmu030.atc_cache));
 }
 
 
@@ -1353,6 +1368,15 @@ uae_u32 mmu030_table_search(uaecptr addr, uae_u32 fc, bool write, int level) {
         return descr_num ? descr_addr[descr_num] : 0;
     }
     
+    /* Drop any other entry for this page, so there is only one */
+    for (i=0; i<ATC030_NUM_ENTRIES; i++) {
+        if (((addr&~mmu030.translation.page.mask)==mmu030.atc[i].logical.addr) &&
+            (mmu030.atc[i].logical.fc==fc) &&
+            mmu030.atc[i].logical.valid) {
+            mmu030.atc[i].logical.valid = false;
+        }
+    }
+
     /* Find an ATC entry to replace */
     /* Search for invalid entry */
     for (i=0; i<ATC030_NUM_ENTRIES; i++) {
@@ -1391,6 +1415,7 @@ uae_u32 mmu030_table_search(uaecptr addr, uae_u32 fc, bool write, int level) {
     }
     mmu030.atc[i].physical.cache_inhibit = cache_inhibit;
     mmu030.atc[i].physical.write_protect = write_protect;
+    mmu030.atc_cache[ATC030_CACHE_INDEX(addr, fc)] = i;
 
 #if MMU030_ATC_DBG_MSG
     write_log("ATC create entry(%i): logical = %08X, physical = %08X, FC = %i\n", i,
@@ -1625,14 +1650,28 @@ uae_u8 mmu030_get_byte_atc(uaecptr addr, int l) {
 /* This function checks if a certain logical address is in the ATC 
  * by comparing the logical address and function code to the values
  * stored in the ATC entries. If a matching entry is found it sets
- * the history bit and returns the cache index of the entry. */
+ * the history bit and returns the cache index of the entry.
+ * mmu030_table_search() drops older entries for the page it adds, so
+ * there is at most one valid entry per page and function code: the one
+ * used last for them is tried first, before searching all entries. */
 int mmu030_logical_is_in_atc(uaecptr addr, uae_u32 fc, bool write) {
-    uaecptr physical_addr = 0;
     uaecptr logical_addr = 0;
     uae_u32 addr_mask = ~mmu030.translation.page.mask;
-    uae_u32 page_index = addr & mmu030.translation.page.mask;
+    int cache_index = ATC030_CACHE_INDEX(addr, fc);
+    
+    int i;
+    i = mmu030.atc_cache[cache_index];
+    if ((addr&addr_mask)==(mmu030.atc[i].logical.addr&addr_mask) &&
+        (mmu030.atc[i].logical.fc==fc) &&
+        mmu030.atc[i].logical.valid) {
+        if (mmu030.atc[i].physical.modified || !write) {
+            mmu030_atc_handle_history_bit(i);
+            return i;
+        }
+        mmu030.atc[i].logical.valid = false;
+        return ATC030_NUM_ENTRIES;
+    }
     
-    int i, j;
     for (i=0; i<ATC030_NUM_ENTRIES; i++) {
         logical_addr = mmu030.atc[i].logical.addr;
         /* If actual address matches address in ATC */
@@ -1644,6 +1683,7 @@ int mmu030_logical_is_in_atc(uaecptr addr, uae_u32 fc, bool write) {
             if (mmu030.atc[i].physical.modified || !write) {
                 /* Maintain history bit */
                 mmu030_atc_handle_history_bit(i);
+                mmu030.atc_cache[cache_index] = i;
                 return i;
             } else {
                 mmu030.atc[i].logical.valid = false;
@@ -1655,17 +1695,17 @@ int mmu030_logical_is_in_atc(uaecptr addr, uae_u32 fc, bool write) {
 
 void mmu030_atc_handle_history_bit(int entry_num) {
     int j;
+    if (mmu030.atc[entry_num].mru)
+        return;
     mmu030.atc[entry_num].mru = 1;
-    for (j=0; j<ATC030_NUM_ENTRIES; j++) {
-        if (!mmu030.atc[j].mru)
-            break;
-    }
+    mmu030.atc_mru_count++;
     /* If there are no more zero-bits, reset all */
-    if (j==ATC030_NUM_ENTRIES) {
+    if (mmu030.atc_mru_count==ATC030_NUM_ENTRIES) {
         for (j=0; j<ATC030_NUM_ENTRIES; j++) {
             mmu030.atc[j].mru = 0;
         }
         mmu030.atc[entry_num].mru = 1;
+        mmu030.atc_mru_count = 1;
 #if MMU030_ATC_DBG_MSG
         write_log("ATC: No more history zero-bits. Reset all.\n");
 #endif
@@ -5,12 +5,15 @@
   or at your option any later version. Read the file gpl.txt for details.
 
   This code handles our table with callbacks for cycle accurate program
-  interruption. We add any pending callback handler into a table so that we do
-  not need to test for every possible interrupt event. We then scan
-  the list if used entries in the table and copy the one with the least cycle
-  count into the global 'PendingInterruptCount' variable. This is then
-  decremented by the execution loop - rather than decrement each and every
-  entry (as the others cannot occur before this one).
+  interruption. Each pending callback handler stores the absolute value of
+  a 64 bit internal clock at which it should occur, and the pending handlers
+  are kept in a small binary min-heap ordered on this value, so that the next
+  interrupt is always at the head of the queue and adding, removing or
+  modifying one handler doesn't need to touch the other ones. The cycle count
+  of the head of the queue is copied into the global 'PendingInterruptCount'
+  variable. This is then decremented by the execution loop, and the internal
+  clock is advanced from it each time the table is updated (as the other
+  interrupts cannot occur before this one).
   We have two methods of adding interrupts; Absolute and Relative.
   Absolute will set values from the time of the previous interrupt (e.g., add
   HBL every 512 cycles), and Relative will add from the current cycle time.
@@ -94,21 +97,31 @@ static void (* const pIntHandlerFunctions[MAX_INTERRUPTS])(void) =
 	FDC_InterruptHandler_Update,
 	Blitter_InterruptHandler,
 	Midi_InterruptHandler_Update,
+	IKBD_InterruptHandler_KeyQueue,
 
 };
 
-/* Event timer structure - keeps next timer to occur in structure so don't need
- * to check all entries */
+/* Event timer structure - pending timers are also stored in 'EventQueue'
+ * so we don't need to check all entries */
 typedef struct
 {
 	bool bUsed;                   /* Is interrupt active? */
-	Sint64 Cycles;
+	Sint64 Time;                  /* Internal clock value when used */
+	Sint64 Cycles;                /* Remaining cycles when stopped */
 	void (*pFunction)(void);
+	int QueuePos;                 /* Index in 'EventQueue' when used */
 } INTERRUPTHANDLER;
 
 static INTERRUPTHANDLER InterruptHandlers[MAX_INTERRUPTS];
 static int ActiveInterrupt=0;
 
+/* Internal clock value at the last update of the interrupt table */
+static Sint64 CycInt_Clock;
+
+/* Min-heap of the used interrupt handlers, ordered on 'Time' */
+static interrupt_id EventQueue[MAX_INTERRUPTS];
+static int EventQueueSize;
+
 static void CycInt_SetNewInterrupt(void);
 
 /*-----------------------------------------------------------------------*/
@@ -123,17 +136,153 @@ void CycInt_Reset(void)
 	PendingInterruptCount = 0;
 	ActiveInterrupt = 0;
 	nCyclesOver = 0;
+	CycInt_Clock = 0;
+	EventQueueSize = 0;
 
 	/* Reset interrupt table */
 	for (i=0; i<MAX_INTERRUPTS; i++)
 	{
 		InterruptHandlers[i].bUsed = false;
+		InterruptHandlers[i].Time = 0;
 		InterruptHandlers[i].Cycles = INT_MAX;
 		InterruptHandlers[i].pFunction = pIntHandlerFunctions[i];
+		InterruptHandlers[i].QueuePos = -1;
+	}
+}
+
+
+/*-----------------------------------------------------------------------*/
+/**
+ * Return true if interrupt 'a' must occur before interrupt 'b'.
+ * Interrupts occurring at the same time are ordered by their ID.
+ */
+static inline bool CycInt_QueueBefore(interrupt_id a, interrupt_id b)
+{
+	if (InterruptHandlers[a].Time != InterruptHandlers[b].Time)
+		return InterruptHandlers[a].Time < InterruptHandlers[b].Time;
+	return a < b;
+}
+
+
+/*-----------------------------------------------------------------------*/
+/**
+ * Store interrupt 'Handler' at position 'Pos' in the event queue
+ */
+static inline void CycInt_QueueSet(int Pos, interrupt_id Handler)
+{
+	EventQueue[Pos] = Handler;
+	InterruptHandlers[Handler].QueuePos = Pos;
+}
+
+
+/*-----------------------------------------------------------------------*/
+/**
+ * Move interrupt 'Handler' to its place in the event queue after
+ * its 'Time' was changed.
+ */
+static void CycInt_QueueFix(interrupt_id Handler)
+{
+	int Pos = InterruptHandlers[Handler].QueuePos;
+	int Child;
+
+	/* Move up while the handler occurs before its parent */
+	while (Pos > 0 && CycInt_QueueBefore(Handler, EventQueue[(Pos-1)/2]))
+	{
+		CycInt_QueueSet(Pos, EventQueue[(Pos-1)/2]);
+		Pos = (Pos-1)/2;
+	}
+
+	/* Move down while one of the children occurs before the handler */
+	while ((Child = 2*Pos+1) < EventQueueSize)
+	{
+		if (Child+1 < EventQueueSize && CycInt_QueueBefore(EventQueue[Child+1], EventQueue[Child]))
+			Child++;
+		if (!CycInt_QueueBefore(EventQueue[Child], Handler))
+			break;
+		CycInt_QueueSet(Pos, EventQueue[Child]);
+		Pos = Child;
+	}
+
+	CycInt_QueueSet(Pos, Handler);
+}
+
+
+/*-----------------------------------------------------------------------*/
+/**
+ * Add interrupt 'Handler' to the event queue
+ */
+static void CycInt_QueueInsert(interrupt_id Handler)
+{
+	CycInt_QueueSet(EventQueueSize++, Handler);
+	CycInt_QueueFix(Handler);
+}
+
+
+/*-----------------------------------------------------------------------*/
+/**
+ * Remove interrupt 'Handler' from the event queue
+ */
+static void CycInt_QueueRemove(interrupt_id Handler)
+{
+	int Pos = InterruptHandlers[Handler].QueuePos;
+	interrupt_id Last = EventQueue[--EventQueueSize];
+
+	InterruptHandlers[Handler].QueuePos = -1;
+	if (Last != Handler)
+	{
+		CycInt_QueueSet(Pos, Last);
+		CycInt_QueueFix(Last);
+	}
+}
+
+
+/*-----------------------------------------------------------------------*/
+/**
+ * Return the number of cycles until interrupt 'Handler' occurs, counted
+ * from the last update of the interrupt table.
+ */
+static inline Sint64 CycInt_HandlerCycles(interrupt_id Handler)
+{
+	if (InterruptHandlers[Handler].bUsed)
+		return InterruptHandlers[Handler].Time - CycInt_Clock;
+	return InterruptHandlers[Handler].Cycles;
+}
+
+
+/*-----------------------------------------------------------------------*/
+/**
+ * Start interrupt 'Handler' to occur at internal clock value 'Time'
+ */
+static void CycInt_StartHandler(interrupt_id Handler, Sint64 Time)
+{
+	InterruptHandlers[Handler].Time = Time;
+	if (InterruptHandlers[Handler].bUsed)
+	{
+		CycInt_QueueFix(Handler);
+	}
+	else
+	{
+		InterruptHandlers[Handler].bUsed = true;
+		CycInt_QueueInsert(Handler);
 	}
 }
 
 
+/*-----------------------------------------------------------------------*/
+/**
+ * Stop interrupt 'Handler', keeping its remaining cycles
+ */
+static void CycInt_StopHandler(interrupt_id Handler)
+{
+	if (!InterruptHandlers[Handler].bUsed)
+		return;
+
+	InterruptHandlers[Handler].Cycles = InterruptHandlers[Handler].Time - CycInt_Clock;
+	InterruptHandlers[Handler].bUsed = false;
+	CycInt_QueueRemove(Handler);
+}
+
+
 /*-----------------------------------------------------------------------*/
 /**
  * Convert interrupt handler function pointer to ID, used for saving
@@ -176,12 +325,15 @@ static void ( *CycInt_IDToHandlerFunction(int ID) )( void )
 void CycInt_MemorySnapShot_Capture(bool bSave)
 {
 	int i,ID;
+	Sint64 Cycles;
+	int SavedPendingCount;
 
-	/* Save/Restore details */
+	/* Save/Restore details, with cycles counted from the last update */
 	for (i=0; i<MAX_INTERRUPTS; i++)
 	{
+		Cycles = CycInt_HandlerCycles(i);
 		MemorySnapShot_Store(&InterruptHandlers[i].bUsed, sizeof(InterruptHandlers[i].bUsed));
-		MemorySnapShot_Store(&InterruptHandlers[i].Cycles, sizeof(InterruptHandlers[i].Cycles));
+		MemorySnapShot_Store(&Cycles, sizeof(Cycles));
 		if (bSave)
 		{
 			/* Convert function to ID */
@@ -193,6 +345,7 @@ void CycInt_MemorySnapShot_Capture(bool bSave)
 			/* Convert ID to function */
 			MemorySnapShot_Store(&ID, sizeof(int));
 			InterruptHandlers[i].pFunction = CycInt_IDToHandlerFunction(ID);
+			InterruptHandlers[i].Time = InterruptHandlers[i].Cycles = Cycles;
 		}
 	}
 	MemorySnapShot_Store(&nCyclesOver, sizeof(nCyclesOver));
@@ -212,7 +365,23 @@ void CycInt_MemorySnapShot_Capture(bool bSave)
 
 
 	if (!bSave)
-		CycInt_SetNewInterrupt();	/* when restoring snapshot, compute current state after */
+	{
+		/* When restoring snapshot, rebuild the event queue with the clock */
+		/* of the last update set to 0 and compute current state after */
+		CycInt_Clock = 0;
+		EventQueueSize = 0;
+		for (i=0; i<MAX_INTERRUPTS; i++)
+		{
+			InterruptHandlers[i].QueuePos = -1;
+			if (InterruptHandlers[i].bUsed)
+				CycInt_QueueInsert(i);
+		}
+
+		/* Keep the cycles already elapsed since the last update */
+		SavedPendingCount = PendingInterruptCount;
+		CycInt_SetNewInterrupt();
+		PendingInterruptCount = SavedPendingCount;
+	}
 }
 
 
@@ -220,38 +389,27 @@ void CycInt_MemorySnapShot_Capture(bool bSave)
 /**
  * Find next interrupt to occur, and store to global variables for decrement
  * in instruction decode loop.
- * Note: Although InterruptHandlers.Cycles and LowestCycleCount are 64 bit
- * variables to get all the cycle counters right (e.g. the DMA sound counter
- * can get very high), PendingInterruptCount is still a 32 bit variable for
- * performance reasons (it's decremented after each CPU instruction).
- * So we have to initialize LowestCycleCount with INT_MAX, not with INT64_MAX!
+ * Note: Although the interrupt times are 64 bit variables to get all the
+ * cycle counters right (e.g. the DMA sound counter can get very high),
+ * PendingInterruptCount is still a 32 bit variable for performance reasons
+ * (it's decremented after each CPU instruction).
+ * So the head of the queue is only used if it occurs before INT_MAX cycles!
  * Since there is always a VBL or HBL counter pending which fits fine into the
  * 32 bit variable, we can be sure that we don't run into problems here.
  */
 static void CycInt_SetNewInterrupt(void)
 {
-	Sint64 LowestCycleCount = INT_MAX;
-	interrupt_id LowestInterrupt = INTERRUPT_NULL, i;
+	interrupt_id LowestInterrupt = INTERRUPT_NULL;
 
 	LOG_TRACE(TRACE_INT, "int set new in video_cyc=%d active_int=%d pending_count=%d\n",
 	          Cycles_GetCounter(CYCLES_COUNTER_VIDEO), ActiveInterrupt, PendingInterruptCount);
 
-	/* Find next interrupt to go off */
-	for (i = INTERRUPT_NULL+1; i < MAX_INTERRUPTS; i++)
-	{
-		/* Is interrupt pending? */
-		if (InterruptHandlers[i].bUsed)
-		{
-			if (InterruptHandlers[i].Cycles < LowestCycleCount)
-			{
-				LowestCycleCount = InterruptHandlers[i].Cycles;
-				LowestInterrupt = i;
-			}
-		}
-	}
+	/* Next interrupt to go off is at the head of the queue */
+	if (EventQueueSize > 0 && CycInt_HandlerCycles(EventQueue[0]) < INT_MAX)
+		LowestInterrupt = EventQueue[0];
 
 	/* Set new counts, active interrupt */
-	PendingInterruptCount = InterruptHandlers[LowestInterrupt].Cycles;
+	PendingInterruptCount = CycInt_HandlerCycles(LowestInterrupt);
 	PendingInterruptFunction = InterruptHandlers[LowestInterrupt].pFunction;
 	ActiveInterrupt = LowestInterrupt;
 
@@ -262,24 +420,20 @@ static void CycInt_SetNewInterrupt(void)
 
 /*-----------------------------------------------------------------------*/
 /**
- * Adjust all interrupt timings, MUST call CycInt_SetNewInterrupt after this.
+ * Advance internal clock to the current time, MUST call CycInt_SetNewInterrupt
+ * after this.
  */
 static void CycInt_UpdateInterrupt(void)
 {
 	Sint64 CycleSubtract;
-	int i;
 
 	/* Find out how many cycles we went over (<=0) */
 	nCyclesOver = PendingInterruptCount;
 	/* Calculate how many cycles have passed, included time we went over */
-	CycleSubtract = InterruptHandlers[ActiveInterrupt].Cycles - nCyclesOver;
+	CycleSubtract = CycInt_HandlerCycles(ActiveInterrupt) - nCyclesOver;
 
-	/* Adjust table */
-	for (i = 0; i < MAX_INTERRUPTS; i++)
-	{
-		if (InterruptHandlers[i].bUsed)
-			InterruptHandlers[i].Cycles -= CycleSubtract;
-	}
+	/* Adjust clock, used handlers are stored with an absolute time */
+	CycInt_Clock += CycleSubtract;
 
 	LOG_TRACE(TRACE_INT, "int upd video_cyc=%d cycle_over=%d cycle_sub=%"PRId64"\n",
 	          Cycles_GetCounter(CYCLES_COUNTER_VIDEO), nCyclesOver, CycleSubtract);
@@ -297,13 +451,13 @@ void CycInt_AcknowledgeInterrupt(void)
 	CycInt_UpdateInterrupt();
 
 	/* Disable interrupt entry which has just occurred */
-	InterruptHandlers[ActiveInterrupt].bUsed = false;
+	CycInt_StopHandler(ActiveInterrupt);
 
 	/* Set new */
 	CycInt_SetNewInterrupt();
 
 	LOG_TRACE(TRACE_INT, "int ack video_cyc=%d active_int=%d active_cyc=%d pending_count=%d\n",
-	               Cycles_GetCounter(CYCLES_COUNTER_VIDEO), ActiveInterrupt, (int)InterruptHandlers[ActiveInterrupt].Cycles, PendingInterruptCount );
+	               Cycles_GetCounter(CYCLES_COUNTER_VIDEO), ActiveInterrupt, (int)CycInt_HandlerCycles(ActiveInterrupt), PendingInterruptCount );
 }
 
 
@@ -320,15 +474,14 @@ void CycInt_AddAbsoluteInterrupt(int CycleTime, int CycleType, interrupt_id Hand
 	if ( ActiveInterrupt > 0 )
 		CycInt_UpdateInterrupt();
 
-	InterruptHandlers[Handler].bUsed = true;
-	InterruptHandlers[Handler].Cycles = INT_CONVERT_TO_INTERNAL((Sint64)CycleTime , CycleType) + nCyclesOver;
+	CycInt_StartHandler(Handler, CycInt_Clock + INT_CONVERT_TO_INTERNAL((Sint64)CycleTime , CycleType) + nCyclesOver);
 
 	/* Set new active int and compute a new value for PendingInterruptCount*/
 	CycInt_SetNewInterrupt();
 
 	LOG_TRACE(TRACE_INT, "int add abs video_cyc=%d handler=%d handler_cyc=%"PRId64" pending_count=%d\n",
 	          Cycles_GetCounter(CYCLES_COUNTER_VIDEO), Handler,
-	          InterruptHandlers[Handler].Cycles, PendingInterruptCount );
+	          CycInt_HandlerCycles(Handler), PendingInterruptCount );
 }
 
 
@@ -355,14 +508,13 @@ void CycInt_AddRelativeInterruptNoOffset(int CycleTime, int CycleType, interrupt
 		CycInt_UpdateInterrupt();
 
 //  nCyclesOver = 0;
-	InterruptHandlers[Handler].bUsed = true;
-	InterruptHandlers[Handler].Cycles = INT_CONVERT_TO_INTERNAL((Sint64)CycleTime , CycleType) + PendingInterruptCount;
+	CycInt_StartHandler(Handler, CycInt_Clock + INT_CONVERT_TO_INTERNAL((Sint64)CycleTime , CycleType) + PendingInterruptCount);
 
 	/* Set new */
 	CycInt_SetNewInterrupt();
 
 	LOG_TRACE(TRACE_INT, "int add rel no_off video_cyc=%d handler=%d handler_cyc=%"PRId64" pending_count=%d\n",
-	               Cycles_GetCounter(CYCLES_COUNTER_VIDEO), Handler, InterruptHandlers[Handler].Cycles, PendingInterruptCount );
+	               Cycles_GetCounter(CYCLES_COUNTER_VIDEO), Handler, CycInt_HandlerCycles(Handler), PendingInterruptCount );
 }
 #endif
 
@@ -385,15 +537,14 @@ void CycInt_AddRelativeInterruptWithOffset(int CycleTime, int CycleType, interru
 	if ( ActiveInterrupt > 0 )
 		CycInt_UpdateInterrupt();
 
-	InterruptHandlers[Handler].bUsed = true;
-	InterruptHandlers[Handler].Cycles = INT_CONVERT_TO_INTERNAL((Sint64)CycleTime , CycleType) + CycleOffset;
+	CycInt_StartHandler(Handler, CycInt_Clock + INT_CONVERT_TO_INTERNAL((Sint64)CycleTime , CycleType) + CycleOffset);
 
 	/* Set new active int and compute a new value for PendingInterruptCount*/
 	CycInt_SetNewInterrupt();
 
 	LOG_TRACE(TRACE_INT, "int add rel offset video_cyc=%d handler=%d handler_cyc=%"PRId64" offset_cyc=%d pending_count=%d\n",
 	          Cycles_GetCounter(CYCLES_COUNTER_VIDEO), Handler,
-	          InterruptHandlers[Handler].Cycles, CycleOffset, PendingInterruptCount);
+	          CycInt_HandlerCycles(Handler), CycleOffset, PendingInterruptCount);
 }
 
 
@@ -411,14 +562,17 @@ void CycInt_ModifyInterrupt(int CycleTime, int CycleType, interrupt_id Handler)
 	if ( ActiveInterrupt > 0 )
 		CycInt_UpdateInterrupt();
 
-	InterruptHandlers[Handler].Cycles += INT_CONVERT_TO_INTERNAL((Sint64)CycleTime , CycleType);
+	if (InterruptHandlers[Handler].bUsed)
+		CycInt_StartHandler(Handler, InterruptHandlers[Handler].Time + INT_CONVERT_TO_INTERNAL((Sint64)CycleTime , CycleType));
+	else
+		InterruptHandlers[Handler].Cycles += INT_CONVERT_TO_INTERNAL((Sint64)CycleTime , CycleType);
 
 	/* Set new active int and compute a new value for PendingInterruptCount*/
 	CycInt_SetNewInterrupt();
 
 	LOG_TRACE(TRACE_INT, "int modify video_cyc=%d handler=%d handler_cyc=%"PRId64" pending_count=%d\n",
 	          Cycles_GetCounter(CYCLES_COUNTER_VIDEO), Handler,
-	          InterruptHandlers[Handler].Cycles, PendingInterruptCount );
+	          CycInt_HandlerCycles(Handler), PendingInterruptCount );
 }
 
 
@@ -433,14 +587,14 @@ void CycInt_RemovePendingInterrupt(interrupt_id Handler)
 	CycInt_UpdateInterrupt();
 
 	/* Stop interrupt after CycInt_UpdateInterrupt, for CycInt_ResumeStoppedInterrupt */
-	InterruptHandlers[Handler].bUsed = false;
+	CycInt_StopHandler(Handler);
 
 	/* Set new */
 	CycInt_SetNewInterrupt();
 
 	LOG_TRACE(TRACE_INT, "int remove pending video_cyc=%d handler=%d handler_cyc=%"PRId64" pending_count=%d\n",
 	          Cycles_GetCounter(CYCLES_COUNTER_VIDEO), Handler,
-	          InterruptHandlers[Handler].Cycles, PendingInterruptCount);
+	          CycInt_HandlerCycles(Handler), PendingInterruptCount);
 }
 
 
@@ -451,7 +605,8 @@ void CycInt_RemovePendingInterrupt(interrupt_id Handler)
 void CycInt_ResumeStoppedInterrupt(interrupt_id Handler)
 {
 	/* Restart interrupt */
-	InterruptHandlers[Handler].bUsed = true;
+	if (!InterruptHandlers[Handler].bUsed)
+		CycInt_StartHandler(Handler, CycInt_Clock + InterruptHandlers[Handler].Cycles);
 
 	/* Update list cycle counts */
 	CycInt_UpdateInterrupt();
@@ -460,7 +615,7 @@ void CycInt_ResumeStoppedInterrupt(interrupt_id Handler)
 
 	LOG_TRACE(TRACE_INT, "int resume stopped video_cyc=%d handler=%d handler_cyc=%"PRId64" pending_count=%d\n",
 	          Cycles_GetCounter(CYCLES_COUNTER_VIDEO), Handler,
-	          InterruptHandlers[Handler].Cycles, PendingInterruptCount);
+	          CycInt_HandlerCycles(Handler), PendingInterruptCount);
 }
 
 
@@ -486,8 +641,8 @@ int CycInt_FindCyclesPassed(interrupt_id Handler, int CycleType)
 {
 	Sint64 CyclesPassed, CyclesFromLastInterrupt;
 
-	CyclesFromLastInterrupt = InterruptHandlers[ActiveInterrupt].Cycles - PendingInterruptCount;
-	CyclesPassed = InterruptHandlers[Handler].Cycles - CyclesFromLastInterrupt;
+	CyclesFromLastInterrupt = CycInt_HandlerCycles(ActiveInterrupt) - PendingInterruptCount;
+	CyclesPassed = CycInt_HandlerCycles(Handler) - CyclesFromLastInterrupt;
 
 	LOG_TRACE(TRACE_INT, "int find passed cyc video_cyc=%d handler=%d last_cyc=%"PRId64" passed_cyc=%"PRId64"\n",
 	          Cycles_GetCounter(CYCLES_COUNTER_VIDEO), Handler,
@@ -663,6 +663,10 @@ void DebugCpu_SetDebugging(void)
 	}	
 	else
 		M68000_UnsetSpecial(SPCFLAG_DEBUGGER);
+
+	/* Debugging or tracing may have changed, make the CPU core */
+	/* select the corresponding run loop */
+	M68000_SetSpecial(SPCFLAG_MODE_CHANGE);
 }
 
 
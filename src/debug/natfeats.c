@@ -66,6 +66,7 @@ static bool nf_name(Uint32 stack, Uint32 subid, Uint32 *retval)
 		str = "Hatari";
 	}
 	buf = (char *)STRAM_ADDR(ptr);
+	STMemory_SetDirtyArea(ptr, len);
 	*retval = snprintf(buf, len, "%s", str);
 	return true;
 }
@@ -121,8 +121,7 @@ const char DmaSnd_fileid[] = "Hatari dmaSnd.c : " __DATE__ " " __TIME__;
 
 static void DmaSnd_Apply_LMC(int nMixBufIdx, int nSamplesToGenerate);
 static void DmaSnd_Set_Tone_Level(int set_bass, int set_treb);
-static float DmaSnd_IIRfilterL(float xn);
-static float DmaSnd_IIRfilterR(float xn);
+static void DmaSnd_IIRfilter(Sint16 (*pBuffer)[2], int nSamples);
 static struct first_order_s *DmaSnd_Treble_Shelf(float g, float fc, float Fs);
 static struct first_order_s *DmaSnd_Bass_Shelf(float g, float fc, float Fs);
 static Sint16 DmaSnd_LowPassFilterLeft(Sint16 in);
@@ -178,6 +177,8 @@ struct lmc1992_s {
 static struct dma_s dma;
 static struct microwire_s microwire;
 static struct lmc1992_s lmc1992;
+static float IIRfilterDataL[2], IIRfilterDataR[2];	/* Bass/Treble filters' delay lines */
+static Sint16 lowPassFilterL[2], lowPassFilterR[2];	/* Low pass filters' delay lines */
 
 /* dB = 20log(gain)  :  gain = antilog(dB/20)                                */
 /* Table gain values = (int)(powf(10.0, dB/20.0)*65536.0 + 0.5)  2dB steps   */
@@ -282,6 +283,25 @@ void DmaSnd_MemorySnapShot_Capture(bool bSave)
 }
 
 
+/*-----------------------------------------------------------------------*/
+/**
+ * Save/Restore the DMA sound for a checkpoint, including the position in
+ * the current sample and the state of the filters, so the same samples
+ * will be generated again.
+ */
+void DmaSnd_MemorySnapShot_CaptureCheckpoint(bool bSave)
+{
+	DmaSnd_MemorySnapShot_Capture(bSave);
+
+	MemorySnapShot_Store(IIRfilterDataL, sizeof(IIRfilterDataL));
+	MemorySnapShot_Store(IIRfilterDataR, sizeof(IIRfilterDataR));
+	MemorySnapShot_Store(lowPassFilterL, sizeof(lowPassFilterL));
+	MemorySnapShot_Store(lowPassFilterR, sizeof(lowPassFilterR));
+	MemorySnapShot_Store(&frameCounter_float, sizeof(frameCounter_float));
+	MemorySnapShot_Store(&DmaInitSample, sizeof(DmaInitSample));
+}
+
+
 /*-----------------------------------------------------------------------*/
 /**
  * This function is called on every HBL to ensure the DMA Audio's FIFO
@@ -482,29 +502,35 @@ void DmaSnd_GenerateSamples(int nMixBufIdx, int nSamplesToGenerate)
 	Sint8 MonoByte , LeftByte , RightByte;
 	unsigned n;
 	Sint64 FreqRatio;
+	int FrameLeft, FrameRight;
 
 
 	/* DMA Audio OFF and FIFO empty : process YM2149's output */
 	if ( !(nDmaSoundControl & DMASNDCTRL_PLAY) && ( dma.FIFO_NbBytes == 0 ) )
 	{
+		/* The DMA output doesn't change during this block */
+		FrameLeft = dma.FrameLeft * -((256*3/4)/4)/4;
+		FrameRight = dma.FrameRight * -((256*3/4)/4)/4;
+
+		nBufIdx = nMixBufIdx;
 		for (i = 0; i < nSamplesToGenerate; i++)
 		{
-			nBufIdx = (nMixBufIdx + i) % MIXBUFFER_SIZE;
-
 			switch (microwire.mixing) {
 				case 1:
 					/* DMA and YM2149 mixing */
-					MixBuffer[nBufIdx][0] = MixBuffer[nBufIdx][0] + dma.FrameLeft * -((256*3/4)/4)/4;
-					MixBuffer[nBufIdx][1] = MixBuffer[nBufIdx][1] + dma.FrameRight * -((256*3/4)/4)/4;
+					MixBuffer[nBufIdx][0] += FrameLeft;
+					MixBuffer[nBufIdx][1] += FrameRight;
 					break;
 				default:
 					/* mixing=0 DMA only */
 					/* mixing=2 DMA and input 2 (YM2149 LPF) -> DMA */
 					/* mixing=3 DMA and input 3 -> DMA */
-					MixBuffer[nBufIdx][0] = dma.FrameLeft * -((256*3/4)/4)/4;
-					MixBuffer[nBufIdx][1] = dma.FrameRight * -((256*3/4)/4)/4;
+					MixBuffer[nBufIdx][0] = FrameLeft;
+					MixBuffer[nBufIdx][1] = FrameRight;
 					break;
 			}
+			if ( ++nBufIdx == MIXBUFFER_SIZE )
+				nBufIdx = 0;
 		}
 
 		/* Apply LMC1992 sound modifications (Bass and Treble) */
@@ -523,6 +549,7 @@ void DmaSnd_GenerateSamples(int nMixBufIdx, int nSamplesToGenerate)
 	if (dma.soundMode & DMASNDMODE_MONO)
 	{
 		/* Mono 8-bit */
+		nBufIdx = nMixBufIdx;
 		for (i = 0; i < nSamplesToGenerate; i++)
 		{
 			if ( DmaInitSample )
@@ -533,8 +560,6 @@ void DmaSnd_GenerateSamples(int nMixBufIdx, int nSamplesToGenerate)
 				DmaInitSample = false;
 			}
 
-			nBufIdx = (nMixBufIdx + i) % MIXBUFFER_SIZE;
-
 			switch (microwire.mixing) {
 				case 1:
 					/* DMA and YM2149 mixing */
@@ -561,11 +586,15 @@ void DmaSnd_GenerateSamples(int nMixBufIdx, int nSamplesToGenerate)
 				n--;
 			}
 			frameCounter_float &= 0xffffffff;			/* only keep the fractional part */
+
+			if ( ++nBufIdx == MIXBUFFER_SIZE )
+				nBufIdx = 0;
 		}
 	}
 	else
 	{
 		/* Stereo 8-bit */
+		nBufIdx = nMixBufIdx;
 		for (i = 0; i < nSamplesToGenerate; i++)
 		{
 			if ( DmaInitSample )
@@ -577,8 +606,6 @@ void DmaSnd_GenerateSamples(int nMixBufIdx, int nSamplesToGenerate)
 				DmaInitSample = false;
 			}
 
-			nBufIdx = (nMixBufIdx + i) % MIXBUFFER_SIZE;
-
 			switch (microwire.mixing) {
 				case 1:
 					/* DMA and YM2149 mixing */
@@ -606,6 +633,9 @@ void DmaSnd_GenerateSamples(int nMixBufIdx, int nSamplesToGenerate)
 				n--;
 			}
 			frameCounter_float &= 0xffffffff;			/* only keep the fractional part */
+
+			if ( ++nBufIdx == MIXBUFFER_SIZE )
+				nBufIdx = 0;
 		}
 	}
 
@@ -622,28 +652,22 @@ void DmaSnd_GenerateSamples(int nMixBufIdx, int nSamplesToGenerate)
  */
 static void DmaSnd_Apply_LMC(int nMixBufIdx, int nSamplesToGenerate)
 {
-	int nBufIdx;
-	int i;
-	Sint32 sample;
+	int n;
 
 	/* Apply LMC1992 sound modifications (Left, Right and Master Volume) */
-	for (i = 0; i < nSamplesToGenerate; i++) {
-		nBufIdx = (nMixBufIdx + i) % MIXBUFFER_SIZE;
+	/* on at most 2 contiguous blocks, as the ring buffer can only wrap once */
+	while (nSamplesToGenerate > 0)
+	{
+		n = MIXBUFFER_SIZE - nMixBufIdx;
+		if (n > nSamplesToGenerate)
+			n = nSamplesToGenerate;
 
-		sample = DmaSnd_IIRfilterL( Subsonic_IIR_HPF_Left( MixBuffer[nBufIdx][0]));
-		if (sample<-32767)						/* check for overflow to clip waveform */
-			sample = -32767;
-		else if (sample>32767)
-			sample = 32767;
-		MixBuffer[nBufIdx][0] = sample;
+		Subsonic_IIR_HPF_Stereo(&MixBuffer[nMixBufIdx], n);
+		DmaSnd_IIRfilter(&MixBuffer[nMixBufIdx], n);
 
-		sample = DmaSnd_IIRfilterR( Subsonic_IIR_HPF_Right(MixBuffer[nBufIdx][1]));
-		if (sample<-32767)						/* check for overflow to clip waveform */
-			sample = -32767;
-		else if (sample>32767)
-			sample = 32767;
-		MixBuffer[nBufIdx][1] = sample;
- 	}
+		nMixBufIdx = (nMixBufIdx + n) % MIXBUFFER_SIZE;
+		nSamplesToGenerate -= n;
+	}
 }
 
 
@@ -1175,56 +1199,64 @@ void DmaSnd_MicrowireMask_WriteWord(void)
 /*-------------------Bass / Treble filter ---------------------------*/
 
 /**
- * Left voice Filter for Bass/Treble.
+ * Bass/Treble filter for a contiguous block of stereo samples.
+ * Both voices use the same biquad coefficients and are processed in the
+ * same loop, with their delay lines kept in local variables ; output is
+ * clipped to 16 bits.
  */
-static float DmaSnd_IIRfilterL(float xn)
+static void DmaSnd_IIRfilter(Sint16 (*pBuffer)[2], int nSamples)
 {
-	static float data[2] = { 0.0, 0.0 };
-	float a, yn;
-
-	/* Input coefficients */
-	/* biquad1  Note: 'a' coefficients are subtracted */
-	a  = lmc1992.left_gain * xn;		/* a=g*xn;               */
-	a -= lmc1992.coef[0] * data[0];		/* a1;  wn-1             */
-	a -= lmc1992.coef[1] * data[1];		/* a2;  wn-2             */
-						/* If coefficient scale  */
-						/* factor = 0.5 then     */
-						/* multiply by 2         */
-	/* Output coefficients */
-	yn  = lmc1992.coef[2] * a;		/* b0;                   */
-	yn += lmc1992.coef[3] * data[0];	/* b1;                   */
-	yn += lmc1992.coef[4] * data[1];	/* b2;                   */
-
-	data[1] = data[0];			/* wn-1 -> wn-2;         */
-	data[0] = a;				/* wn -> wn-1            */
-	return yn;
-}
+	float dataL0 = IIRfilterDataL[0], dataL1 = IIRfilterDataL[1];
+	float dataR0 = IIRfilterDataR[0], dataR1 = IIRfilterDataR[1];
+	float aL, aR, ynL, ynR;
+	Sint32 sample;
+	int i;
 
+	for (i = 0; i < nSamples; i++)
+	{
+		/* Input coefficients */
+		/* biquad1  Note: 'a' coefficients are subtracted */
+		aL  = lmc1992.left_gain * pBuffer[i][0];	/* a=g*xn;               */
+		aR  = lmc1992.right_gain * pBuffer[i][1];
+		aL -= lmc1992.coef[0] * dataL0;			/* a1;  wn-1             */
+		aR -= lmc1992.coef[0] * dataR0;
+		aL -= lmc1992.coef[1] * dataL1;			/* a2;  wn-2             */
+		aR -= lmc1992.coef[1] * dataR1;
+							/* If coefficient scale  */
+							/* factor = 0.5 then     */
+							/* multiply by 2         */
+		/* Output coefficients */
+		ynL  = lmc1992.coef[2] * aL;			/* b0;                   */
+		ynR  = lmc1992.coef[2] * aR;
+		ynL += lmc1992.coef[3] * dataL0;		/* b1;                   */
+		ynR += lmc1992.coef[3] * dataR0;
+		ynL += lmc1992.coef[4] * dataL1;		/* b2;                   */
+		ynR += lmc1992.coef[4] * dataR1;
+
+		dataL1 = dataL0;				/* wn-1 -> wn-2;         */
+		dataR1 = dataR0;
+		dataL0 = aL;					/* wn -> wn-1            */
+		dataR0 = aR;
+
+		sample = ynL;
+		if (sample<-32767)				/* check for overflow to clip waveform */
+			sample = -32767;
+		else if (sample>32767)
+			sample = 32767;
+		pBuffer[i][0] = sample;
 
-/**
- * Right voice Filter for Bass/Treble.
- */
-static float DmaSnd_IIRfilterR(float xn)
-{
-	static float data[2] = { 0.0, 0.0 };
-	float a, yn;
-
-	/* Input coefficients */
-	/* biquad1  Note: 'a' coefficients are subtracted */
-	a  = lmc1992.right_gain * xn;		/* a=g*xn;               */
-	a -= lmc1992.coef[0]*data[0];		/* a1;  wn-1             */
-	a -= lmc1992.coef[1]*data[1];		/* a2;  wn-2             */
-						/* If coefficient scale  */
-						/* factor = 0.5 then     */
-						/* multiply by 2         */
-	/* Output coefficients */
-	yn  = lmc1992.coef[2]*a;		/* b0;                   */
-	yn += lmc1992.coef[3]*data[0];		/* b1;                   */
-	yn += lmc1992.coef[4]*data[1];		/* b2;                   */
-
-	data[1] = data[0];			/* wn-1 -> wn-2;         */
-	data[0] = a;				/* wn -> wn-1            */
-	return yn;
+		sample = ynR;
+		if (sample<-32767)
+			sample = -32767;
+		else if (sample>32767)
+			sample = 32767;
+		pBuffer[i][1] = sample;
+	}
+
+	IIRfilterDataL[0] = dataL0;
+	IIRfilterDataL[1] = dataL1;
+	IIRfilterDataR[0] = dataR0;
+	IIRfilterDataR[1] = dataR1;
 }
 
 /**
@@ -1232,14 +1264,13 @@ static float DmaSnd_IIRfilterR(float xn)
  */
 static Sint16 DmaSnd_LowPassFilterLeft(Sint16 in)
 {
-	static	Sint16	lowPassFilter[2] = { 0, 0 };
-	static	Sint16	out = 0;
+	Sint16	out;
 
 	if (DmaSnd_LowPass)
 	{
-		out = lowPassFilter[0] + (lowPassFilter[1]<<1) + in;
-		lowPassFilter[0] = lowPassFilter[1];
-		lowPassFilter[1] = in;
+		out = lowPassFilterL[0] + (lowPassFilterL[1]<<1) + in;
+		lowPassFilterL[0] = lowPassFilterL[1];
+		lowPassFilterL[1] = in;
 
 		return out; /* Filter Gain = 4 */
 	}else
@@ -1253,14 +1284,13 @@ static Sint16 DmaSnd_LowPassFilterLeft(Sint16 in)
  */
 static Sint16 DmaSnd_LowPassFilterRight(Sint16 in)
 {
-	static	Sint16	lowPassFilter[2] = { 0, 0 };
-	static	Sint16	out = 0;
+	Sint16	out;
 
 	if (DmaSnd_LowPass)
 	{
-		out = lowPassFilter[0] + (lowPassFilter[1]<<1) + in;
-		lowPassFilter[0] = lowPassFilter[1];
-		lowPassFilter[1] = in;
+		out = lowPassFilterR[0] + (lowPassFilterR[1]<<1) + in;
+		lowPassFilterR[0] = lowPassFilterR[1];
+		lowPassFilterR[1] = in;
 
 		return out; /* Filter Gain = 4 */
 	}else
@@ -1591,6 +1591,7 @@ void Crossbar_SendDataToDmaRecord(Sint16 value)
 	}
 	
 	pFrameStart = (Sint8 *)&STRam[dmaRecord.frameStartAddr];
+	STMemory_SetDirtyArea(dmaRecord.frameStartAddr + dmaRecord.frameCounter, 2);
 
 	/* 16 bits stereo mode ? */
 	if (crossbar.is16Bits) {
@@ -1785,12 +1786,12 @@ void Crossbar_GenerateSamples(int nMixBufIdx, int nSamplesToGenerate)
 	Sint16 adc_leftData, adc_rightData, dac_LeftData, dac_RightData;
 	
 	if (crossbar.isDacMuted) {
-		/* Output sound = 0 */
-		for (i = 0; i < nSamplesToGenerate; i++) {
-			nBufIdx = (nMixBufIdx + i) % MIXBUFFER_SIZE;
-			MixBuffer[nBufIdx][0] = 0;
-			MixBuffer[nBufIdx][1] = 0;
-		}
+		/* Output sound = 0 (in at most 2 blocks, as the ring buffer can only wrap once) */
+		n = MIXBUFFER_SIZE - nMixBufIdx;
+		if (n > nSamplesToGenerate)
+			n = nSamplesToGenerate;
+		memset(MixBuffer[nMixBufIdx], 0, n * sizeof(MixBuffer[0]));
+		memset(MixBuffer[0], 0, (nSamplesToGenerate - n) * sizeof(MixBuffer[0]));
 
 		/* Counters are refreshed for when DAC becomes unmuted */
 		dac.readPosition = dac.writePosition;
@@ -1798,10 +1799,9 @@ void Crossbar_GenerateSamples(int nMixBufIdx, int nSamplesToGenerate)
 		return;
 	}
 
+	nBufIdx = nMixBufIdx;
 	for (i = 0; i < nSamplesToGenerate; i++)
 	{
-		nBufIdx = (nMixBufIdx + i) % MIXBUFFER_SIZE;
-
 		/* ADC mixing (PSG sound or microphone sound for left and right channels) */
 		switch (crossbar.codecAdcInput) {
 			case 0:
@@ -1877,6 +1877,9 @@ void Crossbar_GenerateSamples(int nMixBufIdx, int nSamplesToGenerate)
 		n = crossbar.adc2dac_readBufferPosition_float >> 32;				/* number of samples to skip */
 		crossbar.adc2dac_readBufferPosition = (crossbar.adc2dac_readBufferPosition + n) % DACBUFFER_SIZE;
 		crossbar.adc2dac_readBufferPosition_float &= 0xffffffff;			/* only keep the fractional part */
+
+		if (++nBufIdx == MIXBUFFER_SIZE)
+			nBufIdx = 0;
 	}
 }
 
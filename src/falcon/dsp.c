@@ -21,6 +21,11 @@
 */
 
 #include <ctype.h>
+#include <SDL.h>
+#ifdef __LIBRETRO__
+#define SDL_THREAD_PROTOTYPES_ONLY		/* already implemented in rs232.c */
+#endif
+#include <SDL_thread.h>
 
 #include "main.h"
 #include "sysdeps.h"
@@ -48,6 +53,10 @@
 
 #define DSP_HW_OFFSET  0xFFA200
 
+/* SSI frame syncs sent by the DSP thread, replayed by the CPU thread */
+#define DSP_THREAD_EVENTS_MAX	4
+#define DSP_THREAD_EVENT_SC1	-1	/* else, SC2 with this frame value */
+
 
 #if ENABLE_DSP_EMU
 static const char* x_ext_memory_addr_name[] = {
@@ -60,6 +69,29 @@ static const char* x_ext_memory_addr_name[] = {
 };
 
 static Sint32 save_cycles;
+
+/* Optional DSP thread: the CPU thread hands it slices of at least
+ * nDspThreadSlice DSP cycles, and doesn't give it the next one before
+ * the previous one is done, so the DSP never lags more than about
+ * ConfigureParams.System.nDSPThreadSkew cycles behind the 68030.
+ * Every host port, SSI or debugger access first waits for the thread
+ * and runs the DSP up to the current cycle, so the DSP state seen by
+ * the rest of the emulation is the same as without the thread. Only
+ * the host interrupts and SSI frame syncs raised by the DSP itself
+ * reach the CPU side late, when the slice is collected.
+ */
+static SDL_Thread *pDspThread;
+static SDL_sem *pDspThreadRun;		/* CPU thread -> DSP thread: a slice is ready */
+static SDL_sem *pDspThreadDone;		/* DSP thread -> CPU thread: the slice is done */
+static Sint32 nDspThreadSlice;
+static bool bDspThreadBusy;		/* a slice was handed and not collected yet */
+static bool bDspThreadQuit;
+static bool bDspInThread;		/* only set on the DSP thread, while it runs a slice */
+static Sint32 nDspThreadCycles;		/* cycles of the slice, the thread leaves the remainder */
+static bool bDspThreadIrq;
+static bool bDspThreadReplay;		/* forwarding the SSI frame syncs of a slice */
+static int nDspThreadEvents;
+static Sint32 DspThreadEvents[DSP_THREAD_EVENTS_MAX];
 #endif
 
 static bool bDspDebugging;
@@ -74,6 +106,12 @@ bool bDspHostInterruptPending = false;
 #if ENABLE_DSP_EMU
 static void DSP_TriggerHostInterrupt(void)
 {
+	if (bDspInThread)
+	{
+		/* raised by the DSP thread, forwarded when the slice is collected */
+		bDspThreadIrq = true;
+		return;
+	}
 	bDspHostInterruptPending = true;
 	M68000_SetSpecial(SPCFLAG_DSP);
 }
@@ -101,6 +139,157 @@ bool	DSP_ProcessIRQ(void)
 #endif
 
 
+/**
+ * DSP thread: run the slices handed by the CPU thread. A slice stops
+ * early on SSI frame syncs, they have to be replayed by the CPU thread
+ * before the DSP goes on.
+ */
+#if ENABLE_DSP_EMU
+static int DSP_Thread(void *data)
+{
+	for (;;)
+	{
+		SDL_SemWait(pDspThreadRun);
+		if (bDspThreadQuit)
+			break;
+
+		bDspInThread = true;
+		while (nDspThreadCycles > 0 && nDspThreadEvents == 0)
+		{
+			dsp56k_execute_instruction();
+			nDspThreadCycles -= dsp_core.instr_cycle;
+		}
+		bDspInThread = false;
+
+		SDL_SemPost(pDspThreadDone);
+	}
+	return 0;
+}
+#endif
+
+
+/**
+ * Wait for the slice given to the DSP thread (if any), give back its
+ * unused cycles and forward what the DSP did to the other chips.
+ */
+#if ENABLE_DSP_EMU
+static void DSP_ThreadCollect(void)
+{
+	int i;
+
+	if (!bDspThreadBusy)
+		return;
+
+	SDL_SemWait(pDspThreadDone);
+	bDspThreadBusy = false;
+	save_cycles += nDspThreadCycles;
+
+	/* the DSP stopped right after these, it mustn't go on before the
+	 * crossbar got them (even if the crossbar accesses the SSI) */
+	bDspThreadReplay = true;
+	for (i = 0; i < nDspThreadEvents; i++)
+	{
+		if (DspThreadEvents[i] == DSP_THREAD_EVENT_SC1)
+			DSP_SsiTransmit_SC1();
+		else
+			DSP_SsiTransmit_SC2(DspThreadEvents[i]);
+	}
+	nDspThreadEvents = 0;
+	bDspThreadReplay = false;
+
+	if (bDspThreadIrq)
+	{
+		bDspThreadIrq = false;
+		DSP_TriggerHostInterrupt();
+	}
+}
+#endif
+
+
+/**
+ * Bring the DSP up to the current CPU cycle before its state is
+ * accessed from outside: collect the thread's slice, then run what's
+ * left on this thread. When debugging, only collect the slice: the
+ * remaining cycles are run by DSP_Run() where breakpoints are checked.
+ */
+#if ENABLE_DSP_EMU
+static void DSP_Sync(void)
+{
+	if (!pDspThread || bDspThreadReplay)
+		return;
+
+	DSP_ThreadCollect();
+	if (dsp_core.running == 0 || bDspDebugging)
+		return;
+	while (save_cycles > 0)
+	{
+		dsp56k_execute_instruction();
+		save_cycles -= dsp_core.instr_cycle;
+	}
+}
+#endif
+
+
+/**
+ * Start the DSP thread if it's enabled, else the DSP runs on the CPU thread
+ */
+#if ENABLE_DSP_EMU
+static void DSP_StartThread(void)
+{
+	if (ConfigureParams.System.nDSPThreadSkew <= 0)
+		return;
+
+	nDspThreadSlice = ConfigureParams.System.nDSPThreadSkew / 2;
+	if (nDspThreadSlice < 64)
+		nDspThreadSlice = 64;
+	bDspThreadBusy = bDspThreadQuit = bDspThreadIrq = false;
+	nDspThreadEvents = 0;
+
+	pDspThreadRun = SDL_CreateSemaphore(0);
+	pDspThreadDone = SDL_CreateSemaphore(0);
+	if (pDspThreadRun && pDspThreadDone)
+	{
+#if WITH_SDL2
+		pDspThread = SDL_CreateThread(DSP_Thread, "dsp", NULL);
+#else
+		pDspThread = SDL_CreateThread(DSP_Thread, NULL);
+#endif
+	}
+	if (!pDspThread)
+	{
+		Log_Printf(LOG_WARN, "Can't start the DSP thread, running the DSP on the CPU thread.\n");
+		if (pDspThreadRun)
+			SDL_DestroySemaphore(pDspThreadRun);
+		if (pDspThreadDone)
+			SDL_DestroySemaphore(pDspThreadDone);
+		pDspThreadRun = pDspThreadDone = NULL;
+	}
+}
+#endif
+
+
+/**
+ * Stop the DSP thread
+ */
+#if ENABLE_DSP_EMU
+static void DSP_StopThread(void)
+{
+	if (!pDspThread)
+		return;
+
+	DSP_ThreadCollect();
+	bDspThreadQuit = true;
+	SDL_SemPost(pDspThreadRun);
+	SDL_WaitThread(pDspThread, NULL);
+	pDspThread = NULL;
+
+	SDL_DestroySemaphore(pDspThreadRun);
+	SDL_DestroySemaphore(pDspThreadDone);
+	pDspThreadRun = pDspThreadDone = NULL;
+}
+#endif
+
+
 /**
  * Initialize the DSP emulation
  */
@@ -113,6 +302,8 @@ void DSP_Init(void)
 	dsp56k_init_cpu();
 	bDspEnabled = true;
 	save_cycles = 0;
+	DSP_StartThread();
+	M68000_SetSpecial(SPCFLAG_MODE_CHANGE);	/* select the CPU loop running the DSP */
 #endif
 }
 
@@ -125,8 +316,10 @@ void DSP_UnInit(void)
 #if ENABLE_DSP_EMU
 	if (!bDspEnabled)
 		return;
+	DSP_StopThread();
 	dsp_core_shutdown();
 	bDspEnabled = false;
+	M68000_SetSpecial(SPCFLAG_MODE_CHANGE);	/* select the CPU loop without DSP */
 #endif
 }
 
@@ -137,6 +330,7 @@ void DSP_UnInit(void)
 void DSP_Reset(void)
 {
 #if ENABLE_DSP_EMU
+	DSP_ThreadCollect();
 	dsp_core_reset();
 	bDspHostInterruptPending = false;
 	save_cycles = 0;
@@ -150,7 +344,9 @@ void DSP_Reset(void)
 void DSP_MemorySnapShot_Capture(bool bSave)
 {
 #if ENABLE_DSP_EMU
-	if (!bSave)
+	if (bSave)
+		DSP_Sync();
+	else
 		DSP_Reset();
 
 	MemorySnapShot_Store(&bDspEnabled, sizeof(bDspEnabled));
@@ -173,7 +369,20 @@ void DSP_Run(int nHostCycles)
         if (save_cycles <= 0)
                 return;
 
+        if (pDspThread && likely(!bDspDebugging)) {
+		/* hand a new slice to the DSP thread once the previous one is done */
+		if (save_cycles < nDspThreadSlice)
+			return;
+		DSP_ThreadCollect();
+		nDspThreadCycles = save_cycles;
+		save_cycles = 0;
+		bDspThreadBusy = true;
+		SDL_SemPost(pDspThreadRun);
+		return;
+	}
+
         if (unlikely(bDspDebugging)) {
+		DSP_ThreadCollect();
                 while (save_cycles > 0)
                 {
                         dsp56k_execute_instruction();
@@ -197,6 +406,9 @@ void DSP_Run(int nHostCycles)
  */
 void DSP_SetDebugging(bool enabled)
 {
+#if ENABLE_DSP_EMU
+	DSP_Sync();
+#endif
 	bDspDebugging = enabled;
 }
 
@@ -206,6 +418,7 @@ void DSP_SetDebugging(bool enabled)
 Uint16 DSP_GetPC(void)
 {
 #if ENABLE_DSP_EMU
+	DSP_Sync();	/* the debugger gets here first */
 	if (bDspEnabled)
 		return dsp_core.pc;
 	else
@@ -673,6 +886,7 @@ bool DSP_Disasm_SetRegister(const char *arg, Uint32 value)
 Uint32 DSP_SsiReadTxValue(void)
 {
 #if ENABLE_DSP_EMU
+	DSP_Sync();
 	return dsp_core.ssi.transmit_value;
 #else
 	return 0;
@@ -685,6 +899,7 @@ Uint32 DSP_SsiReadTxValue(void)
 void DSP_SsiWriteRxValue(Uint32 value)
 {
 #if ENABLE_DSP_EMU
+	DSP_Sync();
 	dsp_core.ssi.received_value = value & 0xffffff;
 #endif
 }
@@ -696,6 +911,7 @@ void DSP_SsiWriteRxValue(Uint32 value)
 void DSP_SsiReceive_SC0(void)
 {
 #if ENABLE_DSP_EMU
+	DSP_Sync();
 	dsp_core_ssi_Receive_SC0();
 #endif
 }
@@ -709,6 +925,7 @@ void DSP_SsiTransmit_SC0(void)
 void DSP_SsiReceive_SC1(Uint32 FrameCounter)
 {
 #if ENABLE_DSP_EMU
+	DSP_Sync();
 	dsp_core_ssi_Receive_SC1(FrameCounter);
 #endif
 }
@@ -716,6 +933,11 @@ void DSP_SsiReceive_SC1(Uint32 FrameCounter)
 void DSP_SsiTransmit_SC1(void)
 {
 #if ENABLE_DSP_EMU
+	if (bDspInThread)
+	{
+		DspThreadEvents[nDspThreadEvents++] = DSP_THREAD_EVENT_SC1;
+		return;
+	}
 	Crossbar_DmaPlayInHandShakeMode();
 #endif
 }
@@ -723,6 +945,7 @@ void DSP_SsiTransmit_SC1(void)
 void DSP_SsiReceive_SC2(Uint32 FrameCounter)
 {
 #if ENABLE_DSP_EMU
+	DSP_Sync();
 	dsp_core_ssi_Receive_SC2(FrameCounter);
 #endif
 }
@@ -730,6 +953,11 @@ void DSP_SsiReceive_SC2(Uint32 FrameCounter)
 void DSP_SsiTransmit_SC2(Uint32 frame)
 {
 #if ENABLE_DSP_EMU
+	if (bDspInThread)
+	{
+		DspThreadEvents[nDspThreadEvents++] = frame;
+		return;
+	}
 	Crossbar_DmaRecordInHandShakeMode_Frame(frame);
 #endif
 }
@@ -737,6 +965,7 @@ void DSP_SsiTransmit_SC2(Uint32 frame)
 void DSP_SsiReceive_SCK(void)
 {
 #if ENABLE_DSP_EMU
+	DSP_Sync();
 	dsp_core_ssi_Receive_SCK();
 #endif
 }
@@ -757,7 +986,10 @@ void DSP_HandleReadAccess(void)
 	Uint32 addr;
 	Uint8 value;
 	bool multi_access = false; 
-	
+
+#if ENABLE_DSP_EMU
+	DSP_Sync();
+#endif
 	for (addr = IoAccessBaseAddress; addr < IoAccessBaseAddress+nIoMemAccessSize; addr++)
 	{
 #if ENABLE_DSP_EMU
@@ -785,6 +1017,9 @@ void DSP_HandleWriteAccess(void)
 	Uint32 addr;
 	bool multi_access = false; 
 
+#if ENABLE_DSP_EMU
+	DSP_Sync();
+#endif
 	for (addr = IoAccessBaseAddress; addr < IoAccessBaseAddress+nIoMemAccessSize; addr++)
 	{
 #if ENABLE_DSP_EMU
@@ -301,6 +301,16 @@ Uint32 HostScreen_getPaletteColor(Uint8 idx)
 	return palette.native[idx];
 }
 
+/**
+ * Return the whole native palette, so that converters can look up
+ * colors in their inner loops without a function call per pixel.
+ * The table stays valid until the next setPaletteColor/remap.
+ */
+const Uint32 *HostScreen_getPaletteColors(void)
+{
+	return palette.native;
+}
+
 void HostScreen_updatePalette(int colorCount)
 {
 	SDL_SetColors( sdlscrn, palette.standard, 0, colorCount );
@@ -79,6 +79,11 @@ const char VIDEL_fileid[] = "Hatari videl.c : " __DATE__ " " __TIME__;
 #include "video.h"				/* for bUseHighRes variable, maybe unuseful (Laurent) */
 #include "vdi.h"				/* for bUseVDIRes variable,  maybe unuseful (Laurent) */
 
+#if defined(__SSE2__) && SDL_BYTEORDER == SDL_LIL_ENDIAN
+#include <emmintrin.h>
+#define VIDEL_USE_SSE2 1
+#endif
+
 #define Atari2HostAddr(a) (&STRam[a])
 #define VIDEL_COLOR_REGS_BEGIN	0xff9800
 
@@ -115,6 +120,9 @@ struct videl_zoom_s {
 static struct videl_s videl;
 static struct videl_zoom_s videl_zoom;
 
+static Uint8 *videl_chunkyLine;		/* One 16-pixel aligned line of color indexes */
+static int videl_chunkyLineSize;
+
 Uint16 vfc_counter;			/* counter for VFC register $ff82a0 (to be internalized when VIDEL emulation is complete) */
 
 static void VIDEL_memset_uint32(Uint32 *addr, Uint32 color, int count);
@@ -1100,10 +1108,197 @@ static void VIDEL_bitplaneToChunky(Uint16 *atariBitplaneData, Uint16 bpp,
 #endif
 }
 
+#ifdef VIDEL_USE_SSE2
+/**
+ * SSE2 version of VIDEL_bitplaneToChunky() for four consecutive 16-pixel
+ * groups: each 32-bit lane holds one group and goes through the same
+ * mask/shift stages as the scalar code.
+ */
+static void VIDEL_bitplaneToChunky4(Uint16 *atariBitplaneData, Uint16 bpp,
+                                    Uint8 colorValues[64])
+{
+	const __m128i mf0 = _mm_set1_epi32(0xf0f0f0f0), m0f = _mm_set1_epi32(0x0f0f0f0f);
+	const __m128i mcc = _mm_set1_epi32(0xcccccccc), m33 = _mm_set1_epi32(0x33333333);
+	const __m128i ma5 = _mm_set1_epi32(0xaaaa5555), m0a = _mm_set1_epi32(0x0000aaaa);
+	const __m128i m50 = _mm_set1_epi32(0x55550000), m00ff = _mm_set1_epi16(0x00ff);
+	__m128i a, b, c, d, x, ev, od, lo, hi;
+
+	if (bpp == 8) {
+		__m128i r0 = _mm_loadu_si128((__m128i *)&atariBitplaneData[0]);
+		__m128i r1 = _mm_loadu_si128((__m128i *)&atariBitplaneData[8]);
+		__m128i r2 = _mm_loadu_si128((__m128i *)&atariBitplaneData[16]);
+		__m128i r3 = _mm_loadu_si128((__m128i *)&atariBitplaneData[24]);
+		__m128i t0 = _mm_unpacklo_epi32(r0, r1);
+		__m128i t1 = _mm_unpacklo_epi32(r2, r3);
+		__m128i t2 = _mm_unpackhi_epi32(r0, r1);
+		__m128i t3 = _mm_unpackhi_epi32(r2, r3);
+		d = _mm_unpacklo_epi64(t0, t1);
+		c = _mm_unpackhi_epi64(t0, t1);
+		b = _mm_unpacklo_epi64(t2, t3);
+		a = _mm_unpackhi_epi64(t2, t3);
+	} else if (bpp == 4) {
+		__m128i r0 = _mm_loadu_si128((__m128i *)&atariBitplaneData[0]);
+		__m128i r1 = _mm_loadu_si128((__m128i *)&atariBitplaneData[8]);
+		r0 = _mm_shuffle_epi32(r0, _MM_SHUFFLE(3, 1, 2, 0));
+		r1 = _mm_shuffle_epi32(r1, _MM_SHUFFLE(3, 1, 2, 0));
+		d = _mm_unpacklo_epi64(r0, r1);
+		c = _mm_unpackhi_epi64(r0, r1);
+		a = b = _mm_setzero_si128();
+	} else {
+		a = b = c = _mm_setzero_si128();
+		if (bpp == 2) {
+			d = _mm_loadu_si128((__m128i *)&atariBitplaneData[0]);
+		} else {
+			d = _mm_loadl_epi64((__m128i *)&atariBitplaneData[0]);
+			d = _mm_unpacklo_epi16(d, a);
+		}
+	}
+
+	x = a;
+	a = _mm_or_si128(_mm_and_si128(a, mf0), _mm_srli_epi32(_mm_and_si128(c, mf0), 4));
+	c = _mm_or_si128(_mm_slli_epi32(_mm_and_si128(x, m0f), 4), _mm_and_si128(c, m0f));
+	x = b;
+	b = _mm_or_si128(_mm_and_si128(b, mf0), _mm_srli_epi32(_mm_and_si128(d, mf0), 4));
+	d = _mm_or_si128(_mm_slli_epi32(_mm_and_si128(x, m0f), 4), _mm_and_si128(d, m0f));
+
+	x = a;
+	a = _mm_or_si128(_mm_and_si128(a, mcc), _mm_srli_epi32(_mm_and_si128(b, mcc), 2));
+	b = _mm_or_si128(_mm_slli_epi32(_mm_and_si128(x, m33), 2), _mm_and_si128(b, m33));
+	x = c;
+	c = _mm_or_si128(_mm_and_si128(c, mcc), _mm_srli_epi32(_mm_and_si128(d, mcc), 2));
+	d = _mm_or_si128(_mm_slli_epi32(_mm_and_si128(x, m33), 2), _mm_and_si128(d, m33));
+
+	/* Last swap stage, followed by a 16-bit rotate of each lane so that
+	 * the even bytes give pixels 0-7 and the odd bytes pixels 8-15 */
+#define VIDEL_C2P_LAST(v) \
+	v = _mm_or_si128(_mm_or_si128(_mm_and_si128(v, ma5), \
+	                              _mm_slli_epi32(_mm_and_si128(v, m0a), 15)), \
+	                 _mm_srli_epi32(_mm_and_si128(v, m50), 15)); \
+	v = _mm_or_si128(_mm_slli_epi32(v, 16), _mm_srli_epi32(v, 16))
+	VIDEL_C2P_LAST(a);
+	VIDEL_C2P_LAST(b);
+	VIDEL_C2P_LAST(c);
+	VIDEL_C2P_LAST(d);
+#undef VIDEL_C2P_LAST
+
+	/* Even bytes: for each group, 2 pixels from a, b, c and d in turn */
+	ev = _mm_packus_epi16(_mm_and_si128(a, m00ff), _mm_and_si128(b, m00ff));
+	x = _mm_packus_epi16(_mm_and_si128(c, m00ff), _mm_and_si128(d, m00ff));
+	lo = _mm_unpacklo_epi16(ev, x);
+	hi = _mm_unpackhi_epi16(ev, x);
+	ev = _mm_unpacklo_epi16(lo, hi);	/* pixels 0-7 of groups 0 and 1 */
+	x = _mm_unpackhi_epi16(lo, hi);		/* pixels 0-7 of groups 2 and 3 */
+
+	/* Odd bytes */
+	od = _mm_packus_epi16(_mm_srli_epi16(a, 8), _mm_srli_epi16(b, 8));
+	lo = _mm_packus_epi16(_mm_srli_epi16(c, 8), _mm_srli_epi16(d, 8));
+	hi = _mm_unpackhi_epi16(od, lo);
+	lo = _mm_unpacklo_epi16(od, lo);
+	od = _mm_unpacklo_epi16(lo, hi);	/* pixels 8-15 of groups 0 and 1 */
+	lo = _mm_unpackhi_epi16(lo, hi);	/* pixels 8-15 of groups 2 and 3 */
+
+	_mm_storeu_si128((__m128i *)&colorValues[0], _mm_unpacklo_epi64(ev, od));
+	_mm_storeu_si128((__m128i *)&colorValues[16], _mm_unpackhi_epi64(ev, od));
+	_mm_storeu_si128((__m128i *)&colorValues[32], _mm_unpacklo_epi64(x, lo));
+	_mm_storeu_si128((__m128i *)&colorValues[48], _mm_unpackhi_epi64(x, lo));
+}
+#endif
+
+/**
+ * Convert 'count' consecutive 16-pixel groups into chunky color indexes.
+ */
+static void VIDEL_bitplanesToChunky(Uint16 *atariBitplaneData, Uint16 bpp,
+                                    int count, Uint8 *colorValues)
+{
+#ifdef VIDEL_USE_SSE2
+	for (; count >= 4; count -= 4) {
+		VIDEL_bitplaneToChunky4(atariBitplaneData, bpp, colorValues);
+		atariBitplaneData += 4 * bpp;
+		colorValues += 64;
+	}
+#endif
+	for (; count > 0; count--) {
+		VIDEL_bitplaneToChunky(atariBitplaneData, bpp, colorValues);
+		atariBitplaneData += bpp;
+		colorValues += 16;
+	}
+}
+
+/**
+ * Convert one screen line of 'vw' pixels (rounded up to 16) into chunky
+ * color indexes, starting 'hscrolloffset' pixels into the first group.
+ */
+static void VIDEL_lineToChunky(Uint16 *fvram_column, int vbpp, int vw,
+                               int hscrolloffset, Uint8 *chunky)
+{
+	Uint8 color[16];
+	int groups = (vw+15)>>4;
+
+	if (!hscrolloffset) {
+		VIDEL_bitplanesToChunky(fvram_column, vbpp, groups, chunky);
+		return;
+	}
+
+	/* First 16 pixels */
+	VIDEL_bitplaneToChunky(fvram_column, vbpp, color);
+	memcpy(chunky, color+hscrolloffset, 16-hscrolloffset);
+	chunky += 16-hscrolloffset;
+	fvram_column += vbpp;
+	/* Now the main part of the line */
+	VIDEL_bitplanesToChunky(fvram_column, vbpp, groups-1, chunky);
+	chunky += (groups-1) * 16;
+	fvram_column += (groups-1) * vbpp;
+	/* Last pixels of the line for fine scrolling */
+	VIDEL_bitplaneToChunky(fvram_column, vbpp, color);
+	memcpy(chunky, color, hscrolloffset);
+}
+
+/**
+ * Return a buffer for one line of 'vw' pixels (rounded up to 16) of
+ * color indexes. It's only reallocated when the line gets longer.
+ * Return NULL if there's no memory for it.
+ */
+static Uint8 *VIDEL_getChunkyLine(int vw)
+{
+	int size = (vw+15) & ~15;
+	Uint8 *line;
+
+	if (size > videl_chunkyLineSize) {
+		line = realloc(videl_chunkyLine, size);
+		if (!line)
+			return NULL;
+		videl_chunkyLine = line;
+		videl_chunkyLineSize = size;
+	}
+	return videl_chunkyLine;
+}
+
+/**
+ * Copy Falcon true color pixels (big endian RGB565) to a 16-bit host surface.
+ */
+static void VIDEL_copyHighColor(Uint16 *dst, const Uint16 *src, int count)
+{
+#if SDL_BYTEORDER == SDL_BIG_ENDIAN
+	memcpy(dst, src, count<<1);
+#else
+#ifdef VIDEL_USE_SSE2
+	for (; count >= 8; count -= 8) {
+		__m128i v = _mm_loadu_si128((const __m128i *)src);
+		v = _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8));
+		_mm_storeu_si128((__m128i *)dst, v);
+		src += 8;
+		dst += 8;
+	}
+#endif
+	while (count-- > 0)
+		*dst++ = SDL_SwapBE16(*src++);
+#endif
+}
+
 void VIDEL_ConvertScreenNoZoom(int vw, int vh, int vbpp, int nextline)
 {
 	int scrpitch = HostScreen_getPitch();
-	int h, w, j;
+	int h, w;
 
 	Uint16 *fvram = (Uint16 *) Atari2HostAddr(videl.videoBaseAddr);
 	Uint16 *fvram_line;
@@ -1189,11 +1384,6 @@ void VIDEL_ConvertScreenNoZoom(int vw, int vh, int vbpp, int nextline)
 	/* render the graphic area */
 	if (vbpp < 16) {
 		/* Bitplanes modes */
-
-		/* The SDL colors blitting... */
-		Uint8 color[16];
-
-		/* FIXME: The byte swap could be done here by enrolling the loop into 2 each by 8 pixels */
 		switch ( HostScreen_getBpp() ) {
 			case 1:
 			{
@@ -1207,30 +1397,15 @@ void VIDEL_ConvertScreenNoZoom(int vw, int vh, int vbpp, int nextline)
 
 				/* Render the graphical area */
 				for (h = 0; h < vh; h++) {
-					Uint16 *fvram_column = fvram_line;
 					Uint8 *hvram_column = hvram_line;
 
 					/* Left border first */
 					VIDEL_memset_uint8 (hvram_column, HostScreen_getPaletteColor(0), videl.leftBorderSize);
 					hvram_column += videl.leftBorderSize;
 				
-					/* First 16 pixels */
-					VIDEL_bitplaneToChunky(fvram_column, vbpp, color);
-					memcpy(hvram_column, color+hscrolloffset, 16-hscrolloffset);
-					hvram_column += 16-hscrolloffset;
-					fvram_column += vbpp;
-					/* Now the main part of the line */
-					for (w = 1; w < (vw+15)>>4; w++) {
-						VIDEL_bitplaneToChunky( fvram_column, vbpp, color );
-						memcpy(hvram_column, color, 16);
-						hvram_column += 16;
-						fvram_column += vbpp;
-					}
-					/* Last pixels of the line for fine scrolling */
-					if (hscrolloffset) {
-						VIDEL_bitplaneToChunky(fvram_column, vbpp, color);
-						memcpy(hvram_column, color, hscrolloffset);
-					}
+					/* Graphical area */
+					VIDEL_lineToChunky(fvram_line, vbpp, vw, hscrolloffset, hvram_column);
+					hvram_column += ((vw+15) & ~15) - hscrolloffset;
 					/* Right border */
 					VIDEL_memset_uint8 (hvram_column, HostScreen_getPaletteColor(0), rightBorderSize);
 
@@ -1259,6 +1434,10 @@ void VIDEL_ConvertScreenNoZoom(int vw, int vh, int vbpp, int nextline)
 			case 2:
 			{
 				Uint16 *hvram_line = (Uint16 *)hvram;
+				const Uint32 *palette = HostScreen_getPaletteColors();
+				int chunkywidth = (vw+15) & ~15;
+				Uint8 *chunky = VIDEL_getChunkyLine(vw);
+				Uint8 color[16];
 
 				/* Render the upper border */
 				for (h = 0; h < videl.upperBorderSize; h++) {
@@ -1268,32 +1447,24 @@ void VIDEL_ConvertScreenNoZoom(int vw, int vh, int vbpp, int nextline)
 
 				/* Render the graphical area */
 				for (h = 0; h < vh; h++) {
-					Uint16 *fvram_column = fvram_line;
 					Uint16 *hvram_column = hvram_line;
 
 					/* Left border first */
 					VIDEL_memset_uint16 (hvram_column, HostScreen_getPaletteColor(0), videl.leftBorderSize);
 					hvram_column += videl.leftBorderSize;
 				
-					/* First 16 pixels */
-					VIDEL_bitplaneToChunky(fvram_column, vbpp, color);
-					for (j = 0; j < 16 - hscrolloffset; j++) {
-						*hvram_column++ = HostScreen_getPaletteColor(color[j+hscrolloffset]);
-					}
-					fvram_column += vbpp;
-					/* Now the main part of the line */
-					for (w = 1; w < (vw+15)>>4; w++) {
-						VIDEL_bitplaneToChunky( fvram_column, vbpp, color );
-						for (j=0; j<16; j++) {
-							*hvram_column++ = HostScreen_getPaletteColor( color[j] );
+					/* Graphical area */
+					if (chunky) {
+						VIDEL_lineToChunky(fvram_line, vbpp, vw, hscrolloffset, chunky);
+						for (w = 0; w < chunkywidth; w++) {
+							*hvram_column++ = palette[chunky[w]];
 						}
-						fvram_column += vbpp;
-					}
-					/* Last pixels of the line for fine scrolling */
-					if (hscrolloffset) {
-						VIDEL_bitplaneToChunky(fvram_column, vbpp, color);
-						for (j = 0; j < hscrolloffset; j++) {
-							*hvram_column++ = HostScreen_getPaletteColor(color[j]);
+					} else {
+						/* No line buffer, convert one group at a time */
+						for (w = hscrolloffset; w < chunkywidth + hscrolloffset; w++) {
+							if (w == hscrolloffset || !(w & 15))
+								VIDEL_bitplaneToChunky(fvram_line + (w>>4)*vbpp, vbpp, color);
+							*hvram_column++ = palette[color[w & 15]];
 						}
 					}
 					/* Right border */
@@ -1313,6 +1484,10 @@ void VIDEL_ConvertScreenNoZoom(int vw, int vh, int vbpp, int nextline)
 			case 4:
 			{
 				Uint32 *hvram_line = (Uint32 *)hvram;
+				const Uint32 *palette = HostScreen_getPaletteColors();
+				int chunkywidth = (vw+15) & ~15;
+				Uint8 *chunky = VIDEL_getChunkyLine(vw);
+				Uint8 color[16];
 
 				/* Render the upper border */
 				for (h = 0; h < videl.upperBorderSize; h++) {
@@ -1322,32 +1497,24 @@ void VIDEL_ConvertScreenNoZoom(int vw, int vh, int vbpp, int nextline)
 
 				/* Render the graphical area */
 				for (h = 0; h < vh; h++) {
-					Uint16 *fvram_column = fvram_line;
 					Uint32 *hvram_column = hvram_line;
 
 					/* Left border first */
 					VIDEL_memset_uint32 (hvram_column, HostScreen_getPaletteColor(0), videl.leftBorderSize);
 					hvram_column += videl.leftBorderSize;
 				
-					/* First 16 pixels */
-					VIDEL_bitplaneToChunky(fvram_column, vbpp, color);
-					for (j = 0; j < 16 - hscrolloffset; j++) {
-						*hvram_column++ = HostScreen_getPaletteColor(color[j+hscrolloffset]);
-					}
-					fvram_column += vbpp;
-					/* Now the main part of the line */
-					for (w = 1; w < (vw+15)>>4; w++) {
-						VIDEL_bitplaneToChunky( fvram_column, vbpp, color );
-						for (j=0; j<16; j++) {
-							*hvram_column++ = HostScreen_getPaletteColor( color[j] );
+					/* Graphical area */
+					if (chunky) {
+						VIDEL_lineToChunky(fvram_line, vbpp, vw, hscrolloffset, chunky);
+						for (w = 0; w < chunkywidth; w++) {
+							*hvram_column++ = palette[chunky[w]];
 						}
-						fvram_column += vbpp;
-					}
-					/* Last pixels of the line for fine scrolling */
-					if (hscrolloffset) {
-						VIDEL_bitplaneToChunky(fvram_column, vbpp, color);
-						for (j = 0; j < hscrolloffset; j++) {
-							*hvram_column++ = HostScreen_getPaletteColor(color[j]);
+					} else {
+						/* No line buffer, convert one group at a time */
+						for (w = hscrolloffset; w < chunkywidth + hscrolloffset; w++) {
+							if (w == hscrolloffset || !(w & 15))
+								VIDEL_bitplaneToChunky(fvram_line + (w>>4)*vbpp, vbpp, color);
+							*hvram_column++ = palette[color[w & 15]];
 						}
 					}
 					/* Right border */
@@ -1423,25 +1590,14 @@ void VIDEL_ConvertScreenNoZoom(int vw, int vh, int vbpp, int nextline)
 				/* Render the graphical area */
 				for (h = 0; h < vh; h++) {
 					Uint16 *hvram_column = hvram_line;
-#if SDL_BYTEORDER != SDL_BIG_ENDIAN
-					Uint16 *fvram_column;
-#endif
+
 					/* Left border first */
 					VIDEL_memset_uint16 (hvram_column, HostScreen_getPaletteColor(0), videl.leftBorderSize);
 					hvram_column += videl.leftBorderSize;
 
-#if SDL_BYTEORDER == SDL_BIG_ENDIAN
-					/* FIXME: here might be a runtime little/big video endian switch like:
-						if ( " videocard memory in Motorola endian format " false)
-					*/
-					memcpy(hvram_column, fvram_line, vw<<1);
-					hvram_column += vw<<1;
-#else
-					fvram_column = fvram_line;
 					/* Graphical area */
-					for (w = 0; w < vw; w++)
-						*hvram_column ++ = SDL_SwapBE16(*fvram_column++);
-#endif /* SDL_BYTEORDER == SDL_BIG_ENDIAN */
+					VIDEL_copyHighColor(hvram_column, fvram_line, vw);
+					hvram_column += vw;
 
 					/* Right border */
 					VIDEL_memset_uint16 (hvram_column, HostScreen_getPaletteColor(0), rightBorderSize);
@@ -1503,7 +1659,7 @@ void VIDEL_ConvertScreenNoZoom(int vw, int vh, int vbpp, int nextline)
 
 void VIDEL_ConvertScreenZoom(int vw, int vh, int vbpp, int nextline)
 {
-	int i, j, w, h, cursrcline;
+	int i, w, h, cursrcline;
 
 	Uint16 *fvram = (Uint16 *) Atari2HostAddr(videl.videoBaseAddr);
 	Uint16 *fvram_line;
@@ -1592,14 +1748,16 @@ void VIDEL_ConvertScreenZoom(int vw, int vh, int vbpp, int nextline)
 	}
 
 	if (vbpp<16) {
-		Uint8 color[16];
+		/* One complete 16-pixel aligned planar 2 chunky line */
+		Uint8 *p2cline = VIDEL_getChunkyLine(vw);
+
+		if (!p2cline)
+			return;
 
 		/* Bitplanes modes */
 		switch(scrbpp) {
 			case 1:
 			{
-				/* One complete 16-pixel aligned planar 2 chunky line */
-				Uint8 *p2cline = malloc(sizeof(Uint8) * ((vw+15) & ~15));
 				Uint8 *hvram_line = hvram;
 				Uint8 *hvram_column = p2cline;
 
@@ -1619,26 +1777,8 @@ void VIDEL_ConvertScreenZoom(int vw, int vh, int vbpp, int nextline)
 					if (videl_zoom.zoomytable[h] == cursrcline) {
 						memcpy(hvram_line, hvram_line-scrpitch, scrwidth*scrbpp);
 					} else {
-						Uint16 *fvram_column = fvram_line;
-						hvram_column = p2cline;
-
-						/* First 16 pixels of a new line */
-						VIDEL_bitplaneToChunky(fvram_column, vbpp, color);
-						memcpy(hvram_column, color+hscrolloffset, 16-hscrolloffset);
-						hvram_column += 16-hscrolloffset;
-						fvram_column += vbpp;
-						/* Convert main part of the new line */
-						for (w=1; w < (vw+15)>>4; w++) {
-							VIDEL_bitplaneToChunky( fvram_column, vbpp, color );
-							memcpy(hvram_column, color, 16);
-							hvram_column += 16;
-							fvram_column += vbpp;
-						}
-						/* Last pixels of the line for fine scrolling */
-						if (hscrolloffset) {
-							VIDEL_bitplaneToChunky(fvram_column, vbpp, color);
-							memcpy(hvram_column, color, hscrolloffset);
-						}
+						/* Convert the new line */
+						VIDEL_lineToChunky(fvram_line, vbpp, vw, hscrolloffset, p2cline);
 
 						hvram_column = hvram_line;
 
@@ -1677,16 +1817,13 @@ void VIDEL_ConvertScreenZoom(int vw, int vh, int vbpp, int nextline)
 					VIDEL_memset_uint8 (hvram_line, HostScreen_getPaletteColor(0), scrwidth);
 					hvram_line += scrpitch;
 				}
-
-				free(p2cline);
 			}
 			break;
 			case 2:
 			{
-				/* One complete 16-pixel aligned planar 2 chunky line */
-				Uint16 *p2cline = malloc(sizeof(Uint16) * ((vw+15) & ~15));
+				const Uint32 *palette = HostScreen_getPaletteColors();
 				Uint16 *hvram_line = (Uint16 *)hvram;
-				Uint16 *hvram_column = p2cline;
+				Uint16 *hvram_column;
 
 				/* Render the upper border */
 				for (h = 0; h < videl.upperBorderSize * coefy; h++) {
@@ -1703,30 +1840,8 @@ void VIDEL_ConvertScreenZoom(int vw, int vh, int vbpp, int nextline)
 					if (videl_zoom.zoomytable[h] == cursrcline) {
 						memcpy(hvram_line, hvram_line-(scrpitch>>1), scrwidth*scrbpp);
 					} else {
-						Uint16 *fvram_column = fvram_line;
-						hvram_column = p2cline;
-
-						/* First 16 pixels of a new line */
-						VIDEL_bitplaneToChunky(fvram_column, vbpp, color);
-						for (j = 0; j < 16 - hscrolloffset; j++) {
-							*hvram_column++ = HostScreen_getPaletteColor(color[j+hscrolloffset]);
-						}
-						fvram_column += vbpp;
-						/* Convert the main part of the new line */
-						for (w = 1; w < (vw+15)>>4; w++) {
-							VIDEL_bitplaneToChunky( fvram_column, vbpp, color );
-							for (j=0; j<16; j++) {
-								*hvram_column++ = HostScreen_getPaletteColor( color[j] );
-							}
-							fvram_column += vbpp;
-						}
-						/* Last pixels of the new line for fine scrolling */
-						if (hscrolloffset) {
-							VIDEL_bitplaneToChunky(fvram_column, vbpp, color);
-							for (j = 0; j < hscrolloffset; j++) {
-								*hvram_column++ = HostScreen_getPaletteColor(color[j]);
-							}
-						}
+						/* Convert the new line */
+						VIDEL_lineToChunky(fvram_line, vbpp, vw, hscrolloffset, p2cline);
 
 						hvram_column = hvram_line;
 
@@ -1736,7 +1851,7 @@ void VIDEL_ConvertScreenZoom(int vw, int vh, int vbpp, int nextline)
 
 						/* Display the Graphical area */
 						for (w=0; w<(vw*coefx); w++)
-							hvram_column[w] = p2cline[videl_zoom.zoomxtable[w]];
+							hvram_column[w] = palette[p2cline[videl_zoom.zoomxtable[w]]];
 						hvram_column += vw * coefx;
 
 						/* Display the Right border */
@@ -1753,16 +1868,13 @@ void VIDEL_ConvertScreenZoom(int vw, int vh, int vbpp, int nextline)
 					VIDEL_memset_uint16 (hvram_line, HostScreen_getPaletteColor(0), scrwidth);
 					hvram_line += scrpitch>>1;
 				}
-
-				free(p2cline);
 			}
 			break;
 			case 4:
 			{
-				/* One complete 16-pixel aligned planar 2 chunky line */
-				Uint32 *p2cline = malloc(sizeof(Uint32) * ((vw+15) & ~15));
+				const Uint32 *palette = HostScreen_getPaletteColors();
 				Uint32 *hvram_line = (Uint32 *)hvram;
-				Uint32 *hvram_column = p2cline;
+				Uint32 *hvram_column;
 
 				/* Render the upper border */
 				for (h = 0; h < videl.upperBorderSize * coefy; h++) {
@@ -1778,30 +1890,8 @@ void VIDEL_ConvertScreenZoom(int vw, int vh, int vbpp, int nextline)
 					if (videl_zoom.zoomytable[h] == cursrcline) {
 						memcpy(hvram_line, hvram_line-(scrpitch>>2), scrwidth*scrbpp);
 					} else {
-						Uint16 *fvram_column = fvram_line;
-						hvram_column = p2cline;
-
-						/* First 16 pixels of a new line */
-						VIDEL_bitplaneToChunky(fvram_column, vbpp, color);
-						for (j = 0; j < 16 - hscrolloffset; j++) {
-							*hvram_column++ = HostScreen_getPaletteColor(color[j+hscrolloffset]);
-						}
-						fvram_column += vbpp;
-						/* Convert the main part of the new line */
-						for (w = 1; w < (vw+15)>>4; w++) {
-							VIDEL_bitplaneToChunky( fvram_column, vbpp, color );
-							for (j=0; j<16; j++) {
-								*hvram_column++ = HostScreen_getPaletteColor( color[j] );
-							}
-							fvram_column += vbpp;
-						}
-						/* Last pixels of the new line for fine scrolling */
-						if (hscrolloffset) {
-							VIDEL_bitplaneToChunky(fvram_column, vbpp, color);
-							for (j = 0; j < hscrolloffset; j++) {
-								*hvram_column++ = HostScreen_getPaletteColor(color[j]);
-							}
-						}
+						/* Convert the new line */
+						VIDEL_lineToChunky(fvram_line, vbpp, vw, hscrolloffset, p2cline);
 
 						hvram_column = hvram_line;
 						/* Display the Left border */
@@ -1810,7 +1900,7 @@ void VIDEL_ConvertScreenZoom(int vw, int vh, int vbpp, int nextline)
 
 						/* Display the Graphical area */
 						for (w=0; w<(vw*coefx); w++) {
-							hvram_column[w] = p2cline[videl_zoom.zoomxtable[w]];
+							hvram_column[w] = palette[p2cline[videl_zoom.zoomxtable[w]]];
 						}
 						hvram_column += vw * coefx;
 
@@ -1828,8 +1918,6 @@ void VIDEL_ConvertScreenZoom(int vw, int vh, int vbpp, int nextline)
 					VIDEL_memset_uint32 (hvram_line, HostScreen_getPaletteColor(0), scrwidth);
 					hvram_line += scrpitch>>2;
 				}
-
-				free(p2cline);
 			}
 			break;
 		}
@@ -688,6 +688,68 @@ void File_UnLock(FILE *fp)
 }
 
 
+/*-----------------------------------------------------------------------*/
+/**
+ * Read nSize bytes at offset nOffset of the file into pBuffer.
+ * When pread() is available, this bypasses stdio's buffer and doesn't
+ * change the file position : a file must then be accessed only through
+ * File_ReadAt() / File_WriteAt() after it has been opened.
+ * Returns the number of bytes read.
+ */
+size_t File_ReadAt(FILE *fp, void *pBuffer, size_t nSize, off_t nOffset)
+{
+#if HAVE_PREAD
+	size_t nDone = 0;
+	ssize_t ret;
+	int fd = fileno(fp);
+
+	while (nDone < nSize)
+	{
+		ret = pread(fd, (Uint8 *)pBuffer + nDone, nSize - nDone, nOffset + nDone);
+		if (ret < 0 && errno == EINTR)
+			continue;
+		if (ret <= 0)
+			break;
+		nDone += ret;
+	}
+	return nDone;
+#else
+	if (fseeko(fp, nOffset, SEEK_SET) != 0)
+		return 0;
+	return fread(pBuffer, 1, nSize, fp);
+#endif
+}
+
+/*-----------------------------------------------------------------------*/
+/**
+ * Write nSize bytes from pBuffer at offset nOffset of the file.
+ * See File_ReadAt().
+ * Returns the number of bytes written.
+ */
+size_t File_WriteAt(FILE *fp, const void *pBuffer, size_t nSize, off_t nOffset)
+{
+#if HAVE_PREAD
+	size_t nDone = 0;
+	ssize_t ret;
+	int fd = fileno(fp);
+
+	while (nDone < nSize)
+	{
+		ret = pwrite(fd, (const Uint8 *)pBuffer + nDone, nSize - nDone, nOffset + nDone);
+		if (ret < 0 && errno == EINTR)
+			continue;
+		if (ret <= 0)
+			break;
+		nDone += ret;
+	}
+	return nDone;
+#else
+	if (fseeko(fp, nOffset, SEEK_SET) != 0)
+		return 0;
+	return fwrite(pBuffer, 1, nSize, fp);
+#endif
+}
+
 /*-----------------------------------------------------------------------*/
 /**
  * Check if input is available at the specified file descriptor.
@@ -97,6 +97,7 @@ void Floppy_Init(void)
 void Floppy_UnInit(void)
 {
 	Floppy_EjectBothDrives();
+	ZIP_UnInit();
 }
 
 
@@ -160,6 +161,26 @@ void Floppy_MemorySnapShot_Capture(bool bSave)
 }
 
 
+/*-----------------------------------------------------------------------*/
+/**
+ * Save/Restore the drives' state for a checkpoint: the inserted disks
+ * can't change between a checkpoint and its restore, so only the
+ * insert/eject transitions need to be stored.
+ */
+void Floppy_MemorySnapShot_CaptureCheckpoint(bool bSave)
+{
+	int i;
+
+	for (i = 0; i < MAX_FLOPPYDRIVES; i++)
+	{
+		MemorySnapShot_Store(&EmulationDrives[i].TransitionState1,sizeof(EmulationDrives[i].TransitionState1));
+		MemorySnapShot_Store(&EmulationDrives[i].TransitionState1_VBL,sizeof(EmulationDrives[i].TransitionState1_VBL));
+		MemorySnapShot_Store(&EmulationDrives[i].TransitionState2,sizeof(EmulationDrives[i].TransitionState2));
+		MemorySnapShot_Store(&EmulationDrives[i].TransitionState2_VBL,sizeof(EmulationDrives[i].TransitionState2_VBL));
+	}
+}
+
+
 /*-----------------------------------------------------------------------*/
 /**
  * Find which device to boot from (hard drive or floppy).
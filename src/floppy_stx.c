@@ -115,6 +115,18 @@ static STX_SECTOR_STRUCT *STX_FindSector_By_Position ( Uint8 Drive , Uint8 Track
 
 
 
+/*-----------------------------------------------------------------------*/
+/**
+ * Save/Restore the STX state for a checkpoint : the inserted images are
+ * the same ones when restoring, so STX_State's pointers to their parsed
+ * structures remain valid and don't need to be recomputed.
+ */
+void STX_MemorySnapShot_CaptureCheckpoint(bool bSave)
+{
+	MemorySnapShot_Store ( &STX_State , sizeof (STX_State) );
+}
+
+
 /*-----------------------------------------------------------------------*/
 /**
  * Save/Restore snapshot of local variables('MemorySnapShot_Store' handles type)
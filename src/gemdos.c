@@ -125,13 +125,36 @@ typedef struct
 	bool bUsed;
 	int  nentries;                      /* number of entries in fs directory */
 	int  centry;                        /* current entry # */
-	struct dirent **found;              /* legal files */
+	char **found;                       /* legal files */
 	char path[MAX_GEMDOS_PATH];                /* sfirst path */
+	Uint32 nSearch;                     /* Fsfirst() it's for, see checkpoints */
 } INTERNAL_DTA;
 
+/* Cache of host directory contents, so that matching GEMDOS names
+ * doesn't need to read the whole directory again for every access
+ */
+#define DIRCACHE_DIRS      16
+#define DIRCACHE_RACY_SECS 2       /* mtime granularity of host file systems */
+
+typedef struct
+{
+	char *path;                         /* host directory, NULL if unused */
+	dev_t dev;
+	ino_t ino;
+	time_t mtime;
+	bool bTrusted;                      /* false if dir may change without new mtime */
+	int  nentries;
+	char **names;                       /* entries in readdir() order */
+	char **sorted;                      /* entries in alphasort() order, or NULL */
+	Uint32 nLastUse;
+} DIR_CACHE;
+
 static FILE_HANDLE  FileHandles[MAX_FILE_HANDLES];
 static INTERNAL_DTA InternalDTAs[MAX_DTAS_FILES];
+static DIR_CACHE    DirCache[DIRCACHE_DIRS];
+static Uint32       nDirCacheUse;
 static int DTAIndex;        /* Circular index into above */
+static Uint32 nDTASearches; /* Number of Fsfirst() calls, to tell their DTAs apart */
 static DTA *pDTA;           /* Our GEMDOS hard drive Disk Transfer Address structure */
 static Uint16 CurrentDrive; /* Current drive (0=A,1=B,2=C etc...) */
 static Uint32 act_pd;       /* Used to get a pointer to the current basepage */
@@ -272,7 +295,7 @@ static Uint8 GemDOS_ConvertAttribute(mode_t mode)
  * Populate the DTA buffer with file info.
  * @return   0 if entry is ok, 1 if entry should be skipped, < 0 for errors.
  */
-static int PopulateDTA(char *path, struct dirent *file)
+static int PopulateDTA(char *path, const char *name)
 {
 	/* TODO: host file path can be longer than MAX_GEMDOS_PATH */
 	char tempstr[MAX_GEMDOS_PATH];
@@ -280,7 +303,7 @@ static int PopulateDTA(char *path, struct dirent *file)
 	DATETIME DateTime;
 	int nFileAttr, nAttrMask;
 
-	snprintf(tempstr, sizeof(tempstr), "%s%c%s", path, PATHSEP, file->d_name);
+	snprintf(tempstr, sizeof(tempstr), "%s%c%s", path, PATHSEP, name);
 
 	if (stat(tempstr, &filestat) != 0)
 	{
@@ -290,6 +313,7 @@ static int PopulateDTA(char *path, struct dirent *file)
 
 	if (!pDTA)
 		return -2;   /* no DTA pointer set */
+	STMemory_SetDirtyArea((Uint8 *)pDTA - STRam, sizeof(DTA));
 
 	/* Check file attributes (check is done according to the Profibuch) */
 	nFileAttr = GemDOS_ConvertAttribute(filestat.st_mode);
@@ -300,10 +324,10 @@ static int PopulateDTA(char *path, struct dirent *file)
 	GemDOS_DateTime2Tos(filestat.st_mtime, &DateTime, tempstr);
 
 	/* convert to atari-style uppercase */
-	Str_Filename2TOSname(file->d_name, pDTA->dta_name);
+	Str_Filename2TOSname(name, pDTA->dta_name);
 #if DEBUG_PATTERN_MATCH
 	fprintf(stderr, "GEMDOS: host: %s -> GEMDOS: %s\n",
-		file->d_name, pDTA->dta_name);
+		name, pDTA->dta_name);
 #endif
 	do_put_mem_long(pDTA->dta_size, filestat.st_size);
 	do_put_mem_word(pDTA->dta_time, DateTime.timeword);
@@ -318,20 +342,189 @@ static int PopulateDTA(char *path, struct dirent *file)
 /**
  * Clear a used DTA structure.
  */
-static void ClearInternalDTA(void)
+static void ClearInternalDTA(int Index)
 {
 	int i;
 
 	/* clear the old DTA structure */
-	if (InternalDTAs[DTAIndex].found != NULL)
+	if (InternalDTAs[Index].found != NULL)
 	{
-		for (i=0; i < InternalDTAs[DTAIndex].nentries; i++)
-			free(InternalDTAs[DTAIndex].found[i]);
-		free(InternalDTAs[DTAIndex].found);
-		InternalDTAs[DTAIndex].found = NULL;
+		for (i=0; i < InternalDTAs[Index].nentries; i++)
+			free(InternalDTAs[Index].found[i]);
+		free(InternalDTAs[Index].found);
+		InternalDTAs[Index].found = NULL;
+	}
+	InternalDTAs[Index].nentries = 0;
+	InternalDTAs[Index].bUsed = false;
+}
+
+
+/*-----------------------------------------------------------------------*/
+/**
+ * Free the contents of a directory cache entry.
+ */
+static void GemDOS_DirCacheFree(DIR_CACHE *pDir)
+{
+	int i;
+
+	for (i = 0; i < pDir->nentries; i++)
+		free(pDir->names[i]);
+	free(pDir->names);
+	free(pDir->sorted);
+	free(pDir->path);
+	memset(pDir, 0, sizeof(*pDir));
+}
+
+
+/*-----------------------------------------------------------------------*/
+/**
+ * Forget all cached directories, after GEMDOS itself changed
+ * a directory on the host.
+ */
+static void GemDOS_DirCacheFlush(void)
+{
+	int i;
+
+	for (i = 0; i < DIRCACHE_DIRS; i++)
+	{
+		if (DirCache[i].path)
+			GemDOS_DirCacheFree(&DirCache[i]);
+	}
+}
+
+
+/*-----------------------------------------------------------------------*/
+/**
+ * Read the entries of given host directory into a cache entry.
+ * Return false if the directory can't be read.
+ */
+static bool GemDOS_DirCacheRead(DIR_CACHE *pDir, const char *path, struct stat *pStat)
+{
+	struct dirent *entry;
+	char **names;
+	int size = 0;
+	DIR *dir;
+
+	dir = opendir(path);
+	if (!dir)
+		return false;
+
+	pDir->path = strdup(path);
+	if (!pDir->path)
+	{
+		closedir(dir);
+		return false;
+	}
+	while ((entry = readdir(dir)))
+	{
+		if (pDir->nentries == size)
+		{
+			size = size ? 2 * size : 64;
+			names = realloc(pDir->names, size * sizeof(char *));
+			if (!names)
+				break;
+			pDir->names = names;
+		}
+		Str_DecomposedToPrecomposedUtf8(entry->d_name, entry->d_name);   /* for OSX */
+		pDir->names[pDir->nentries] = strdup(entry->d_name);
+		if (!pDir->names[pDir->nentries])
+			break;
+		pDir->nentries++;
+	}
+	closedir(dir);
+
+	pDir->dev = pStat->st_dev;
+	pDir->ino = pStat->st_ino;
+	pDir->mtime = pStat->st_mtime;
+	/* Entries changed within the mtime granularity can't be noticed */
+	pDir->bTrusted = (entry == NULL && pStat->st_mtime < time(NULL) - DIRCACHE_RACY_SECS);
+	return true;
+}
+
+
+/*-----------------------------------------------------------------------*/
+/**
+ * Return cache entry with the contents of given host directory,
+ * or NULL if the directory can't be read. Cached contents are used
+ * as long as the directory modification time doesn't change.
+ */
+static DIR_CACHE *GemDOS_DirCacheGet(const char *dirpath)
+{
+	char path[FILENAME_MAX];
+	DIR_CACHE *pDir = NULL;
+	struct stat dirstat;
+	int i, len;
+
+	/* Don't depend on a trailing separator */
+	len = strlen(dirpath);
+	if (len >= (int)sizeof(path))
+		return NULL;
+	strcpy(path, dirpath);
+	while (len > 1 && path[len-1] == PATHSEP)
+		path[--len] = '\0';
+
+	if (stat(path, &dirstat) != 0 || !S_ISDIR(dirstat.st_mode))
+		return NULL;
+
+	for (i = 0; i < DIRCACHE_DIRS; i++)
+	{
+		if (DirCache[i].path && strcmp(DirCache[i].path, path) == 0)
+		{
+			pDir = &DirCache[i];
+			if (pDir->bTrusted && pDir->mtime == dirstat.st_mtime
+			    && pDir->dev == dirstat.st_dev && pDir->ino == dirstat.st_ino)
+			{
+				pDir->nLastUse = ++nDirCacheUse;
+				return pDir;
+			}
+			break;
+		}
+	}
+
+	/* Not cached or outdated, replace least recently used entry */
+	if (!pDir)
+	{
+		pDir = &DirCache[0];
+		for (i = 1; i < DIRCACHE_DIRS; i++)
+		{
+			if (DirCache[i].nLastUse < pDir->nLastUse)
+				pDir = &DirCache[i];
+		}
+	}
+	if (pDir->path)
+		GemDOS_DirCacheFree(pDir);
+
+	if (!GemDOS_DirCacheRead(pDir, path, &dirstat))
+	{
+		GemDOS_DirCacheFree(pDir);
+		return NULL;
+	}
+	pDir->nLastUse = ++nDirCacheUse;
+	return pDir;
+}
+
+
+static int dircache_alphasort(const void *a, const void *b)
+{
+	return strcoll(*(char * const *)a, *(char * const *)b);
+}
+
+/*-----------------------------------------------------------------------*/
+/**
+ * Return cached directory entries sorted like alphasort() does,
+ * or NULL if there's not enough memory.
+ */
+static char **GemDOS_DirCacheSorted(DIR_CACHE *pDir)
+{
+	if (!pDir->sorted && pDir->nentries > 0)
+	{
+		pDir->sorted = malloc(pDir->nentries * sizeof(char *));
+		if (!pDir->sorted)
+			return NULL;
+		memcpy(pDir->sorted, pDir->names, pDir->nentries * sizeof(char *));
+		qsort(pDir->sorted, pDir->nentries, sizeof(char *), dircache_alphasort);
 	}
-	InternalDTAs[DTAIndex].nentries = 0;
-	InternalDTAs[DTAIndex].bUsed = false;
+	return pDir->sorted;
 }
 
 
@@ -505,9 +698,10 @@ void GemDOS_Reset(void)
 	}
 	for (DTAIndex = 0; DTAIndex < MAX_DTAS_FILES; DTAIndex++)
 	{
-		ClearInternalDTA();
+		ClearInternalDTA(DTAIndex);
 	}
 	DTAIndex = 0;
+	GemDOS_DirCacheFlush();
 
 	/* Reset */
 	bInitGemDOS = false;
@@ -832,6 +1026,97 @@ void GemDOS_MemorySnapShot_Capture(bool bSave)
 }
 
 
+/*-----------------------------------------------------------------------*/
+/**
+ * Save/Restore the GEMDOS state for a checkpoint. Unlike in snapshots,
+ * the host files are still there when the checkpoint is restored, so
+ * the open file handles are kept and just moved back to their saved
+ * positions. Files opened since the checkpoint get closed, and the ones
+ * closed since then are opened again. Data written to them is not undone.
+ * The DTAs used by an Fsfirst() since the checkpoint can't be brought
+ * back, they're cleared (Fsnext() then finds no more files).
+ * The checkpoint size doesn't depend on the open files.
+ */
+void GemDOS_MemorySnapShot_CaptureCheckpoint(bool bSave)
+{
+	char szName[MAX_GEMDOS_PATH];
+	unsigned int Addr;
+	bool bUsed;
+	Uint32 Basepage, nSearch;
+	long nPos;
+	int i;
+
+	MemorySnapShot_Store(&DTAIndex, sizeof(DTAIndex));
+	MemorySnapShot_Store(&act_pd, sizeof(act_pd));
+	if (bSave)
+		Addr = ((Uint8 *)pDTA - STRam);
+	MemorySnapShot_Store(&Addr, sizeof(Addr));
+	if (!bSave)
+		pDTA = (DTA *)(STRam + Addr);
+	MemorySnapShot_Store(&CurrentDrive, sizeof(CurrentDrive));
+	MemorySnapShot_Store(&nAttrSFirst, sizeof(nAttrSFirst));
+	MemorySnapShot_Store(ForcedHandles, sizeof(ForcedHandles));
+
+	for (i = 0; i < ARRAYSIZE(InternalDTAs); i++)
+	{
+		if (bSave)
+			nSearch = InternalDTAs[i].nSearch;
+		MemorySnapShot_Store(&nSearch, sizeof(nSearch));
+		MemorySnapShot_Store(&InternalDTAs[i].centry, sizeof(InternalDTAs[i].centry));
+		if (!bSave && InternalDTAs[i].nSearch != nSearch)
+			ClearInternalDTA(i);
+	}
+
+	for (i = 0; i < ARRAYSIZE(FileHandles); i++)
+	{
+		bUsed = FileHandles[i].bUsed;
+		if (bSave)
+		{
+			Basepage = 0;
+			nPos = -1;
+			memset(szName, 0, sizeof(szName));
+			if (bUsed)
+			{
+				Basepage = FileHandles[i].Basepage;
+				nPos = ftell(FileHandles[i].FileHandle);
+				strcpy(szName, FileHandles[i].szActualName);
+			}
+		}
+		MemorySnapShot_Store(&bUsed, sizeof(bUsed));
+		MemorySnapShot_Store(&Basepage, sizeof(Basepage));
+		MemorySnapShot_Store(&nPos, sizeof(nPos));
+		MemorySnapShot_Store(szName, sizeof(szName));
+		if (bSave)
+			continue;
+
+		if (!bUsed)
+		{
+			GemDOS_CloseFileHandle(i);
+			continue;
+		}
+
+		if (FileHandles[i].bUsed && strcmp(FileHandles[i].szActualName, szName) != 0)
+			GemDOS_CloseFileHandle(i);
+		if (!FileHandles[i].bUsed)
+		{
+			FileHandles[i].FileHandle = fopen(szName, "rb+");
+			if (FileHandles[i].FileHandle == NULL)
+				FileHandles[i].FileHandle = fopen(szName, "rb");
+			if (FileHandles[i].FileHandle == NULL)
+			{
+				Log_Printf(LOG_WARN, "GEMDOS checkpoint: can't reopen '%s'\n", szName);
+				continue;
+			}
+			strcpy(FileHandles[i].szActualName, szName);
+			FileHandles[i].bUsed = true;
+		}
+		FileHandles[i].Basepage = Basepage;
+		if (nPos >= 0)
+			fseek(FileHandles[i].FileHandle, nPos, SEEK_SET);
+	}
+}
+
+
 /*-----------------------------------------------------------------------*/
 /**
  * Return free PC file handle table index, or -1 if error
@@ -983,46 +1268,30 @@ static int GemDOS_FileName2HardDriveID(char *pszFileName)
 static char* match_host_dir_entry(const char *path, const char *name, bool pattern)
 {
 #define MAX_UTF8_NAME_LEN (3*(8+1+3)+1) /* UTF-8 can have up to 3 bytes per character */
-	struct dirent *entry;
+	DIR_CACHE *pDir;
 	char *match = NULL;
-	DIR *dir;
 	char nameHost[MAX_UTF8_NAME_LEN];
+	int i;
 
 	Str_AtariToHost(name, nameHost, MAX_UTF8_NAME_LEN, INVALID_CHAR);
 	name = nameHost;
 	
-	dir = opendir(path);
-	if (!dir)
+	pDir = GemDOS_DirCacheGet(path);
+	if (!pDir)
 		return NULL;
 
 #if DEBUG_PATTERN_MATCH
 	fprintf(stderr, "GEMDOS match '%s'%s in '%s'", name, pattern?" (pattern)":"", path);
 #endif
-	if (pattern)
+	for (i = 0; i < pDir->nentries; i++)
 	{
-		while ((entry = readdir(dir)))
+		if (pattern ? fsfirst_match(name, pDir->names[i])
+		            : strcasecmp(name, pDir->names[i]) == 0)
 		{
-			Str_DecomposedToPrecomposedUtf8(entry->d_name, entry->d_name);   /* for OSX */
-			if (fsfirst_match(name, entry->d_name))
-			{
-				match = strdup(entry->d_name);
-				break;
-			}
-		}
-	}
-	else
-	{
-		while ((entry = readdir(dir)))
-		{
-			Str_DecomposedToPrecomposedUtf8(entry->d_name, entry->d_name);   /* for OSX */
-			if (strcasecmp(name, entry->d_name) == 0)
-			{
-				match = strdup(entry->d_name);
-				break;
-			}
+			match = strdup(pDir->names[i]);
+			break;
 		}
 	}
-	closedir(dir);
 #if DEBUG_PATTERN_MATCH
 	fprintf(stderr, "-> '%s'\n", match);
 #endif
@@ -1598,7 +1867,10 @@ static bool GemDOS_MkDir(Uint32 Params)
 	
 	/* Attempt to make directory */
 	if (mkdir(psDirPath, 0755) == 0)
+	{
+		GemDOS_DirCacheFlush();
 		Regs[REG_D0] = GEMDOS_EOK;
+	}
 	else
 		Regs[REG_D0] = errno2gemdos(errno, ERROR_PATH);
 	free(psDirPath);
@@ -1650,7 +1922,10 @@ static bool GemDOS_RmDir(Uint32 Params)
 
 	/* Attempt to remove directory */
 	if (rmdir(psDirPath) == 0)
+	{
+		GemDOS_DirCacheFlush();
 		Regs[REG_D0] = GEMDOS_EOK;
+	}
 	else
 		Regs[REG_D0] = errno2gemdos(errno, ERROR_PATH);
 	free(psDirPath);
@@ -1807,6 +2082,8 @@ static bool GemDOS_Create(Uint32 Params)
 
 	if (FileHandles[Index].FileHandle != NULL)
 	{
+		GemDOS_DirCacheFlush();
+
 		/* FIXME: implement other Mode attributes
 		 * - GEMDOS_FILE_ATTRIB_HIDDEN       (FA_HIDDEN)
 		 * - GEMDOS_FILE_ATTRIB_SYSTEM_FILE  (FA_SYSTEM)
@@ -2095,6 +2372,7 @@ static bool GemDOS_Read(Uint32 Params)
 		return true;
 	}
 	/* And read data in */
+	STMemory_SetDirtyArea(Addr, Size);
 	nBytesRead = fread(pBuffer, 1, Size, FileHandles[Handle].FileHandle);
 	
 	if (ferror(FileHandles[Handle].FileHandle))
@@ -2218,7 +2496,10 @@ static bool GemDOS_FDelete(Uint32 Params)
 
 	/* Now delete file?? */
 	if (unlink(psActualFileName) == 0)
+	{
+		GemDOS_DirCacheFlush();
 		Regs[REG_D0] = GEMDOS_EOK;          /* OK */
+	}
 	else
 		Regs[REG_D0] = errno2gemdos(errno, ERROR_FILE);
 
@@ -2573,7 +2854,7 @@ static int GemDOS_Pexec(Uint32 Params)
  */
 static bool GemDOS_SNext(void)
 {
-	struct dirent **temp;
+	char **temp;
 	Uint32 nDTA;
 	int Index;
 	int ret;
@@ -2645,11 +2926,11 @@ static bool GemDOS_SFirst(Uint32 Params)
 	char szActualFileName[MAX_GEMDOS_PATH];
 	char *pszFileName;
 	const char *dirmask;
-	struct dirent **files;
+	DIR_CACHE *pDir;
+	char **files;
 	Uint32 nDTA;
 	int Drive;
-	DIR *fsdir;
-	int i,j,count;
+	int i,j;
 
 	/* Find filename to search for */
 	pszFileName = (char *)STRAM_ADDR(STMemory_ReadLong(Params));
@@ -2680,6 +2961,7 @@ static bool GemDOS_SFirst(Uint32 Params)
 		return true;
 	}
 	pDTA = (DTA *)STRAM_ADDR(nDTA);
+	STMemory_SetDirtyArea(nDTA, sizeof(DTA));
 
 	/* Populate DTA, set index for our use */
 	do_put_mem_word(pDTA->index, DTAIndex);
@@ -2687,8 +2969,9 @@ static bool GemDOS_SFirst(Uint32 Params)
 	do_put_mem_long(pDTA->magic, DTA_MAGIC_NUMBER);
 
 	if (InternalDTAs[DTAIndex].bUsed == true)
-		ClearInternalDTA();
+		ClearInternalDTA(DTAIndex);
 	InternalDTAs[DTAIndex].bUsed = true;
+	InternalDTAs[DTAIndex].nSearch = ++nDTASearches;
 
 	/* Were we looking for the volume label? */
 	if (nAttrSFirst == GEMDOS_FILE_ATTRIB_VOLUME_LABEL)
@@ -2704,19 +2987,17 @@ static bool GemDOS_SFirst(Uint32 Params)
 	 * TODO: host path may not fit into InternalDTA
 	 */
 	fsfirst_dirname(szActualFileName, InternalDTAs[DTAIndex].path);
-	fsdir = opendir(InternalDTAs[DTAIndex].path);
+	pDir = GemDOS_DirCacheGet(InternalDTAs[DTAIndex].path);
 
-	if (fsdir == NULL)
+	if (pDir == NULL)
 	{
 		Regs[REG_D0] = GEMDOS_EPTHNF;        /* Path not found */
 		return true;
 	}
-	/* close directory */
-	closedir(fsdir);
 
-	count = scandir(InternalDTAs[DTAIndex].path, &files, 0, alphasort);
+	files = GemDOS_DirCacheSorted(pDir);
 	/* File (directory actually) not found */
-	if (count < 0)
+	if (files == NULL)
 	{
 		Regs[REG_D0] = GEMDOS_EFILNF;
 		return true;
@@ -2724,22 +3005,22 @@ static bool GemDOS_SFirst(Uint32 Params)
 
 	InternalDTAs[DTAIndex].centry = 0;          /* current entry is 0 */
 	dirmask = fsfirst_dirmask(szActualFileName);/* directory mask part */
-	InternalDTAs[DTAIndex].found = files;       /* get files */
+	InternalDTAs[DTAIndex].found = malloc(pDir->nentries * sizeof(char *));
+	if (!InternalDTAs[DTAIndex].found)
+	{
+		Regs[REG_D0] = GEMDOS_ENSMEM;
+		return true;
+	}
 
-	/* count & copy the entries that match our mask and discard the rest */
+	/* count & copy the entries that match our mask */
 	j = 0;
-	for (i=0; i < count; i++)
+	for (i=0; i < pDir->nentries; i++)
 	{
-		Str_DecomposedToPrecomposedUtf8(files[i]->d_name, files[i]->d_name);   /* for OSX */
-		if (fsfirst_match(dirmask, files[i]->d_name))
-		{
-			InternalDTAs[DTAIndex].found[j] = files[i];
-			j++;
-		}
-		else
+		if (fsfirst_match(dirmask, files[i]))
 		{
-			free(files[i]);
-			files[i] = NULL;
+			InternalDTAs[DTAIndex].found[j] = strdup(files[i]);
+			if (InternalDTAs[DTAIndex].found[j])
+				j++;
 		}
 	}
 	InternalDTAs[DTAIndex].nentries = j; /* set number of legal entries */
@@ -2747,7 +3028,7 @@ static bool GemDOS_SFirst(Uint32 Params)
 	/* No files of that match, return error code */
 	if (j==0)
 	{
-		free(files);
+		free(InternalDTAs[DTAIndex].found);
 		InternalDTAs[DTAIndex].found = NULL;
 		Regs[REG_D0] = GEMDOS_EFILNF;        /* File not found */
 		return true;
@@ -2807,7 +3088,10 @@ static bool GemDOS_Rename(Uint32 Params)
 
 	/* Rename files */
 	if (rename(szOldActualFileName,szNewActualFileName) == 0)
+	{
+		GemDOS_DirCacheFlush();
 		Regs[REG_D0] = GEMDOS_EOK;
+	}
 	else
 		Regs[REG_D0] = errno2gemdos(errno, ERROR_FILE);
 	return true;
@@ -3118,7 +3402,7 @@ void GemDOS_Info(Uint32 bShowOpcodes)
 		for (j = 0; j < entries; j++)
 		{
 			fprintf(stderr, "  - %d: %s%s\n",
-				j, InternalDTAs[i].found[j]->d_name,
+				j, InternalDTAs[i].found[j],
 				j == centry ? " *" : "");
 		}
 		fprintf(stderr, "  Fsnext entry = %d.\n", centry);
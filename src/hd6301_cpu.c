@@ -18,14 +18,12 @@
 #include <SDL.h>
 
 #include "hd6301_cpu.h"
+#include "log.h"
 
 
 /**********************************
  *	Defines
  **********************************/
-#define HD6301_DISASM 		1
-#define HD6301_DISPLAY_REGS	1
-
 /* HD6301 Disasm and debug code */
 #define HD6301_DISASM_UNDEFINED		0
 #define HD6301_DISASM_NONE		1
@@ -51,8 +49,8 @@
  *	macros for CCR processing
  *	adapted from mame project
  **********************************/
-#define HD6301_SET_Z8(a)	hd6301_reg_CCR |= (((Uint8)(a) == 0) << 1)
-#define HD6301_SET_Z16(a)	hd6301_reg_CCR |= (((Uint16)(a) == 0) << 1)
+#define HD6301_SET_Z8(a)	hd6301_reg_CCR |= (((Uint8)(a) == 0) << 2)
+#define HD6301_SET_Z16(a)	hd6301_reg_CCR |= (((Uint16)(a) == 0) << 2)
 #define HD6301_SET_N8(a)	hd6301_reg_CCR |= (((a) & 0x80) >> 4)
 #define HD6301_SET_N16(a)	hd6301_reg_CCR |= (((a) & 0x8000) >> 12)
 #define HD6301_SET_C8(a)	hd6301_reg_CCR |= (((a) & 0x100) >> 8)
@@ -316,9 +314,9 @@ static void hd6301_stx_ext(void);
  **********************************/
 static char hd6301_str_instr[50];
 
-static struct hd6301_opcode_t hd6301_opcode;
+static const struct hd6301_opcode_t *hd6301_opcode;
 
-static struct hd6301_opcode_t hd6301_opcode_table[256] = {
+static const struct hd6301_opcode_t hd6301_opcode_table[256] = {
 
 	{0x00, 0, hd6301_undefined,	0,	"", 			HD6301_DISASM_UNDEFINED},
 	{0x01, 1, hd6301_nop,		1,	"nop", 			HD6301_DISASM_NONE},
@@ -632,24 +630,23 @@ void hd6301_execute_one_instruction(void)
 	hd6301_cur_inst = hd6301_read_memory(hd6301_reg_PC);
 
 	/* Get opcode to execute */
-	hd6301_opcode = hd6301_opcode_table[hd6301_cur_inst];
+	hd6301_opcode = &hd6301_opcode_table[hd6301_cur_inst];
 
 	/* disasm opcode ? */
-#ifdef HD6301_DISASM
-	hd6301_disasm();
-#endif
+	if (LOG_TRACE_LEVEL(TRACE_IKBD_EXEC))
+		hd6301_disasm();
+
 	/* execute opcode  */
-	hd6301_opcode.op_func();
+	hd6301_opcode->op_func();
 
-#ifdef HD6301_DISPLAY_REGS
-	hd6301_display_registers();
-#endif
+	if (LOG_TRACE_LEVEL(TRACE_IKBD_EXEC))
+		hd6301_display_registers();
 
 	/* Increment instruction cycles */
-	hd6301_cycles += hd6301_opcode.op_n_cycles;
+	hd6301_cycles += hd6301_opcode->op_n_cycles;
 
 	/* Increment PC register */
-	hd6301_reg_PC += hd6301_opcode.op_bytes;
+	hd6301_reg_PC += hd6301_opcode->op_bytes;
 
 	/* post process interrupts */
 
@@ -4966,21 +4963,21 @@ static void hd6301_stx_ext(void)
  */
 void hd6301_disasm(void)
 {
-	switch(hd6301_opcode.op_disasm) {
+	switch(hd6301_opcode->op_disasm) {
 		case HD6301_DISASM_UNDEFINED:
 			sprintf(hd6301_str_instr, "0x%02x : unknown instruction", hd6301_cur_inst);
 			break;
 		case HD6301_DISASM_NONE: 
-			sprintf(hd6301_str_instr, hd6301_opcode.op_mnemonic, 0);
+			sprintf(hd6301_str_instr, hd6301_opcode->op_mnemonic, 0);
 			break;
 		case HD6301_DISASM_MEMORY8: 
-			sprintf(hd6301_str_instr, hd6301_opcode.op_mnemonic, hd6301_read_memory(hd6301_reg_PC+1));
+			sprintf(hd6301_str_instr, hd6301_opcode->op_mnemonic, hd6301_read_memory(hd6301_reg_PC+1));
 			break;
 		case HD6301_DISASM_MEMORY16: 
-			sprintf(hd6301_str_instr, hd6301_opcode.op_mnemonic, hd6301_get_memory_ext());
+			sprintf(hd6301_str_instr, hd6301_opcode->op_mnemonic, hd6301_get_memory_ext());
 			break;
 		case HD6301_DISASM_XIM: 
-			sprintf(hd6301_str_instr, hd6301_opcode.op_mnemonic,
+			sprintf(hd6301_str_instr, hd6301_opcode->op_mnemonic,
 				hd6301_read_memory(hd6301_reg_PC+1),
 				hd6301_read_memory(hd6301_reg_PC+2));
 			break;
@@ -168,8 +168,7 @@ static void HDC_Cmd_Seek(SCSI_CTRLR *ctr)
 	LOG_TRACE(TRACE_SCSI_CMD, "HDC: SEEK (%s), LBA=%i",
 	          HDC_CmdInfoStr(ctr), dev->nLastBlockAddr);
 
-	if (dev->nLastBlockAddr < dev->hdSize &&
-	    fseeko(dev->image_file, (off_t)dev->nLastBlockAddr * 512L, SEEK_SET) == 0)
+	if (dev->nLastBlockAddr < dev->hdSize)
 	{
 		LOG_TRACE(TRACE_SCSI_CMD, " -> OK\n");
 		ctr->returnCode = HD_STATUS_OK;
@@ -344,6 +343,7 @@ static void HDC_Cmd_ModeSense(SCSI_CTRLR *ctr)
 		size_t blocks;
 		blocks = dev->hdSize;
 
+		STMemory_SetDirtyArea(nDmaAddr, 16);
 		STRam[nDmaAddr+0] = 0;
 		STRam[nDmaAddr+1] = 0;
 		STRam[nDmaAddr+2] = 0;
@@ -413,6 +413,7 @@ static void HDC_Cmd_ReadCapacity(SCSI_CTRLR *ctr)
 	if (STMemory_ValidArea(nDmaAddr, 8))
 	{
 		int nSectors = dev->hdSize - 1;
+		STMemory_SetDirtyArea(nDmaAddr, 8);
 		STRam[nDmaAddr++] = (nSectors >> 24) & 0xFF;
 		STRam[nDmaAddr++] = (nSectors >> 16) & 0xFF;
 		STRam[nDmaAddr++] = (nSectors >> 8) & 0xFF;
@@ -454,9 +455,7 @@ static void HDC_Cmd_WriteSector(SCSI_CTRLR *ctr)
 	LOG_TRACE(TRACE_SCSI_CMD, "HDC: WRITE SECTOR (%s) with LBA 0x%x from 0x%x",
 	          HDC_CmdInfoStr(ctr), dev->nLastBlockAddr, nDmaAddr);
 
-	/* seek to the position */
-	if (dev->nLastBlockAddr >= dev->hdSize ||
-	    fseeko(dev->image_file, (off_t)dev->nLastBlockAddr * 512L, SEEK_SET) != 0)
+	if (dev->nLastBlockAddr >= dev->hdSize)
 	{
 		ctr->returnCode = HD_STATUS_ERROR;
 		dev->nLastError = HD_REQSENS_INVADDR;
@@ -467,8 +466,9 @@ static void HDC_Cmd_WriteSector(SCSI_CTRLR *ctr)
 #ifndef DISALLOW_HDC_WRITE
 		if (STMemory_ValidArea(nDmaAddr, 512 * HDC_GetCount(ctr)))
 		{
-			n = fwrite(&STRam[nDmaAddr], 512,
-				   HDC_GetCount(ctr), dev->image_file);
+			/* DMA straight from ST RAM to the image, only complete sectors count */
+			n = File_WriteAt(dev->image_file, &STRam[nDmaAddr], 512 * HDC_GetCount(ctr),
+			                 (off_t)dev->nLastBlockAddr * 512L) / 512;
 		}
 		else
 		{
@@ -513,9 +513,7 @@ static void HDC_Cmd_ReadSector(SCSI_CTRLR *ctr)
 	LOG_TRACE(TRACE_SCSI_CMD, "HDC: READ SECTOR (%s) with LBA 0x%x to 0x%x",
 	          HDC_CmdInfoStr(ctr), dev->nLastBlockAddr, nDmaAddr);
 
-	/* seek to the position */
-	if (dev->nLastBlockAddr >= dev->hdSize ||
-	    fseeko(dev->image_file, (off_t)dev->nLastBlockAddr * 512L, SEEK_SET) != 0)
+	if (dev->nLastBlockAddr >= dev->hdSize)
 	{
 		ctr->returnCode = HD_STATUS_ERROR;
 		dev->nLastError = HD_REQSENS_INVADDR;
@@ -524,8 +522,10 @@ static void HDC_Cmd_ReadSector(SCSI_CTRLR *ctr)
 	{
 		if (STMemory_ValidArea(nDmaAddr, 512 * HDC_GetCount(ctr)))
 		{
-			n = fread(&STRam[nDmaAddr], 512,
-				   HDC_GetCount(ctr), dev->image_file);
+			/* DMA straight from the image to ST RAM, only complete sectors count */
+			STMemory_SetDirtyArea(nDmaAddr, 512 * HDC_GetCount(ctr));
+			n = File_ReadAt(dev->image_file, &STRam[nDmaAddr], 512 * HDC_GetCount(ctr),
+			                (off_t)dev->nLastBlockAddr * 512L) / 512;
 		}
 		else
 		{
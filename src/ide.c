@@ -488,8 +488,7 @@ static int bdrv_read(BlockDriverState *bs, int64_t sector_num,
 
 	len = nb_sectors * 512;
 
-	fseeko(bs->fhndl, sector_num*512, SEEK_SET);
-	ret = fread(buf, 1, len, bs->fhndl);
+	ret = File_ReadAt(bs->fhndl, buf, len, (off_t)sector_num*512);
 	if (ret != len)
 	{
 		fprintf(stderr,"IDE: bdrv_read error (%d != %d length) at sector %lu!\n", ret, len, (unsigned long)sector_num);
@@ -522,8 +521,7 @@ static int bdrv_write(BlockDriverState *bs, int64_t sector_num,
 
 	len = nb_sectors * 512;
 
-	fseeko(bs->fhndl, sector_num*512, SEEK_SET);
-	ret = fwrite(buf, 1, len, bs->fhndl);
+	ret = File_WriteAt(bs->fhndl, buf, len, (off_t)sector_num*512);
 	if (ret != len)
 	{
 		fprintf(stderr,"IDE: bdrv_write error (%d != %d length) at sector %lu!\n", ret, len,  (unsigned long)sector_num);
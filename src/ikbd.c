@@ -119,6 +119,17 @@ static bool bMouseDisabled, bJoystickDisabled;
 static bool bDuringResetCriticalTime, bBothMouseAndJoy;
 static bool bMouseEnabledDuringReset;
 
+/* Host key events waiting to be reported at a later cycle, see IKBD_PressSTKeyAfter() */
+#define	IKBD_KEY_QUEUE_SIZE	64
+typedef struct {
+	Uint8	ScanCode;
+	bool	bPress;
+	int	Delay;				/* cpu cycles after the previous event in the queue */
+} IKBD_KEY_EVENT;
+
+static IKBD_KEY_EVENT	KeyQueue[ IKBD_KEY_QUEUE_SIZE ];
+static int		KeyQueueHead , KeyQueueCount;
+
 
 
 
@@ -483,6 +494,8 @@ void	IKBD_Reset ( bool bCold )
 	pIKBD->RSR = 0;
 	pIKBD->SCI_RX_Size = 0;
 
+	/* Forget host key events not reported yet */
+	KeyQueueHead = KeyQueueCount = 0;
 
 	/* On cold reset, clear the whole RAM (including clock data) */
 	/* On warm reset, the clock data should be kept */
@@ -634,6 +647,9 @@ void IKBD_MemorySnapShot_Capture(bool bSave)
 	MemorySnapShot_Store(&bDuringResetCriticalTime, sizeof(bDuringResetCriticalTime));
 	MemorySnapShot_Store(&bBothMouseAndJoy, sizeof(bBothMouseAndJoy));
 	MemorySnapShot_Store(&bMouseEnabledDuringReset, sizeof(bMouseEnabledDuringReset));
+	MemorySnapShot_Store(&KeyQueue, sizeof(KeyQueue));
+	MemorySnapShot_Store(&KeyQueueHead, sizeof(KeyQueueHead));
+	MemorySnapShot_Store(&KeyQueueCount, sizeof(KeyQueueCount));
 
 	/* restore custom 6301 program if needed */
 	MemorySnapShot_Store(&IKBD_ExeMode, sizeof(IKBD_ExeMode));
@@ -1737,6 +1753,70 @@ void IKBD_PressSTKey(Uint8 ScanCode, bool bPress)
 }
 
 
+/*-----------------------------------------------------------------------*/
+/**
+ * Same as IKBD_PressSTKey, but report the key nCpuCycles after the previous
+ * key given to this function (or now if no key is waiting). This keeps the
+ * spacing between host key events that are received in a batch, instead of
+ * reporting them all at the same cycle.
+ */
+void IKBD_PressSTKeyAfter(Uint8 ScanCode, bool bPress, int nCpuCycles)
+{
+	IKBD_KEY_EVENT	*pEvent;
+
+	if ( KeyQueueCount == 0 && nCpuCycles <= 0 )
+	{
+		IKBD_PressSTKey ( ScanCode , bPress );
+		return;
+	}
+
+	/* Queue is full : report the oldest key now */
+	if ( KeyQueueCount == IKBD_KEY_QUEUE_SIZE )
+	{
+		pEvent = &KeyQueue[ KeyQueueHead ];
+		IKBD_PressSTKey ( pEvent->ScanCode , pEvent->bPress );
+		KeyQueueHead = ( KeyQueueHead + 1 ) % IKBD_KEY_QUEUE_SIZE;
+		KeyQueueCount--;
+	}
+
+	pEvent = &KeyQueue[ ( KeyQueueHead + KeyQueueCount ) % IKBD_KEY_QUEUE_SIZE ];
+	pEvent->ScanCode = ScanCode;
+	pEvent->bPress = bPress;
+	pEvent->Delay = nCpuCycles > 0 ? nCpuCycles : 0;
+	KeyQueueCount++;
+
+	if ( KeyQueueCount == 1 )
+		CycInt_AddRelativeInterrupt ( pEvent->Delay , INT_CPU_CYCLE , INTERRUPT_IKBD_KEYQUEUE );
+}
+
+
+/*-----------------------------------------------------------------------*/
+/**
+ * Report the keys from IKBD_PressSTKeyAfter whose cycle was reached,
+ * then restart the timer for the next one.
+ */
+void IKBD_InterruptHandler_KeyQueue(void)
+{
+	IKBD_KEY_EVENT	*pEvent;
+
+	CycInt_AcknowledgeInterrupt();
+
+	while ( KeyQueueCount > 0 )
+	{
+		pEvent = &KeyQueue[ KeyQueueHead ];
+		IKBD_PressSTKey ( pEvent->ScanCode , pEvent->bPress );
+		KeyQueueHead = ( KeyQueueHead + 1 ) % IKBD_KEY_QUEUE_SIZE;
+		KeyQueueCount--;
+
+		if ( KeyQueueCount > 0 && KeyQueue[ KeyQueueHead ].Delay > 0 )
+		{
+			CycInt_AddRelativeInterrupt ( KeyQueue[ KeyQueueHead ].Delay , INT_CPU_CYCLE , INTERRUPT_IKBD_KEYQUEUE );
+			break;
+		}
+	}
+}
+
+
 /*-----------------------------------------------------------------------*/
 /**
  * This function is called regularly to automatically send keyboard, mouse
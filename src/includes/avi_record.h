@@ -11,6 +11,7 @@
 
 #define	AVI_RECORD_VIDEO_CODEC_BMP	1
 #define	AVI_RECORD_VIDEO_CODEC_PNG	2
+#define	AVI_RECORD_VIDEO_CODEC_ZLIB	3
 
 #define	AVI_RECORD_AUDIO_CODEC_PCM	1
 
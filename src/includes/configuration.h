@@ -307,6 +307,7 @@ typedef struct
   MACHINETYPE nMachineType;
   bool bBlitter;                  /* TRUE if Blitter is enabled */
   DSPTYPE nDSPType;               /* how to "emulate" DSP */
+  int nDSPThreadSkew;             /* >0: run the DSP on its own thread, max. cycles behind */
   bool bRealTimeClock;
   bool bPatchTimerD;
   bool bFastBoot;                 /* Enable to patch TOS for fast boot */
@@ -28,6 +28,7 @@ typedef enum
   INTERRUPT_FDC,
   INTERRUPT_BLITTER,
   INTERRUPT_MIDI,
+  INTERRUPT_IKBD_KEYQUEUE,
 
   MAX_INTERRUPTS
 } interrupt_id;
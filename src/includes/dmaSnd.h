@@ -16,6 +16,7 @@ extern Uint16 nDmaSoundControl;
 
 extern void DmaSnd_Reset(bool bCold);
 extern void DmaSnd_MemorySnapShot_Capture(bool bSave);
+extern void DmaSnd_MemorySnapShot_CaptureCheckpoint(bool bSave);
 extern void DmaSnd_GenerateSamples(int nMixBufIdx, int nSamplesToGenerate);
 extern void DmaSnd_STE_HBL_Update(void);
 
@@ -35,6 +35,8 @@ extern FILE *HFile_Close(FILE *fp);
 extern bool File_Lock(FILE *fp);
 extern void File_UnLock(FILE *fp);
 extern bool File_InputAvailable(FILE *fp);
+extern size_t File_ReadAt(FILE *fp, void *pBuffer, size_t nSize, off_t nOffset);
+extern size_t File_WriteAt(FILE *fp, const void *pBuffer, size_t nSize, off_t nOffset);
 extern void File_MakeAbsoluteSpecialName(char *pszFileName);
 extern void File_MakeAbsoluteName(char *pszFileName);
 extern void File_MakeValidPathName(char *pPathName);
@@ -52,6 +52,7 @@ extern void Floppy_Init(void);
 extern void Floppy_UnInit(void);
 extern void Floppy_Reset(void);
 extern void Floppy_MemorySnapShot_Capture(bool bSave);
+extern void Floppy_MemorySnapShot_CaptureCheckpoint(bool bSave);
 extern void Floppy_GetBootDrive(void);
 extern bool Floppy_IsWriteProtected(int Drive);
 extern const char* Floppy_SetDiskFileNameNone(int Drive);
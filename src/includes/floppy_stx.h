@@ -156,6 +156,7 @@ typedef struct {
 
 
 extern void	STX_MemorySnapShot_Capture(bool bSave);
+extern void	STX_MemorySnapShot_CaptureCheckpoint(bool bSave);
 extern bool	STX_FileNameIsSTX(const char *pszFileName, bool bAllowGZ);
 extern bool	STX_FileNameToSave ( const char *FilenameSTX , char *FilenameSave );
 extern Uint8	*STX_ReadDisk(int Drive, const char *pszFileName, long *pImageSize, int *pImageType);
@@ -91,10 +91,12 @@ extern void IKBD_MemorySnapShot_Capture(bool bSave);
 
 extern void IKBD_InterruptHandler_ResetTimer(void);
 extern void IKBD_InterruptHandler_AutoSend(void);
+extern void IKBD_InterruptHandler_KeyQueue(void);
 
 extern void IKBD_UpdateClockOnVBL ( void );
 
 
 extern void IKBD_PressSTKey(Uint8 ScanCode, bool bPress);
+extern void IKBD_PressSTKeyAfter(Uint8 ScanCode, bool bPress, int nCpuCycles);
 
 #endif  /* HATARI_IKBD_H */
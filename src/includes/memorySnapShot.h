@@ -10,3 +10,9 @@ extern void MemorySnapShot_Skip(int Nb);
 extern void MemorySnapShot_Store(void *pData, int Size);
 extern void MemorySnapShot_Capture(const char *pszFileName, bool bConfirm);
 extern void MemorySnapShot_Restore(const char *pszFileName, bool bConfirm);
+extern size_t MemorySnapShot_GetMemorySize(void);
+extern size_t MemorySnapShot_CaptureMemory(void *pBuffer, size_t nBufSize);
+extern bool MemorySnapShot_RestoreMemory(const void *pBuffer, size_t nBufSize);
+extern size_t MemorySnapShot_GetCheckpointSize(void);
+extern size_t MemorySnapShot_CaptureCheckpoint(void *pBuffer, size_t nBufSize);
+extern bool MemorySnapShot_RestoreCheckpoint(const void *pBuffer, size_t nBufSize);
@@ -13,6 +13,9 @@
 
 extern int ScreenSnapShot_SavePNG_ToFile(SDL_Surface *surface, FILE *fp, int png_compression_level, int png_filter ,
 		int CropLeft , int CropRight , int CropTop , int CropBottom );
+extern int ScreenSnapShot_SavePNG_ToMemory(SDL_Surface *surface, Uint8 **ppBuf, int *pBufAlloc,
+		int png_compression_level, int png_filter ,
+		int CropLeft , int CropRight , int CropTop , int CropBottom );
 extern void ScreenSnapShot_SaveScreen(void);
 
 #endif /* ifndef HATARI_SCREENSNAPSHOT_H */
@@ -52,6 +52,7 @@ extern void Sound_Init(void);
 extern void Sound_Reset(void);
 extern void Sound_ResetBufferIndex(void);
 extern void Sound_MemorySnapShot_Capture(bool bSave);
+extern void Sound_MemorySnapShot_CaptureCheckpoint(bool bSave);
 extern void Sound_Update(bool FillFrame);
 extern void Sound_Update_VBL(void);
 extern void Sound_WriteReg( int reg , Uint8 data );
@@ -61,6 +62,7 @@ extern bool Sound_AreWeRecording(void);
 extern void Sound_SetYmVolumeMixing(void);
 extern ymsample Subsonic_IIR_HPF_Left(ymsample x0);
 extern ymsample Subsonic_IIR_HPF_Right(ymsample x0);
+extern void Subsonic_IIR_HPF_Stereo(Sint16 (*pBuffer)[2], int nSamples);
 
 
 #endif  /* HATARI_SOUND_H */
@@ -23,6 +23,15 @@ extern Uint8 STRam[16*1024*1024];
 
 extern Uint32 STRamEnd;
 
+/* ST memory space is split in 4 KiB pages to track which ones were
+ * modified since the last key frame, for checkpoints.
+ */
+#define STMEMORY_PAGE_SHIFT	12
+#define STMEMORY_PAGE_SIZE	(1 << STMEMORY_PAGE_SHIFT)
+#define STMEMORY_NUM_PAGES	(0x1000000 >> STMEMORY_PAGE_SHIFT)
+
+extern Uint8 STMemory_DirtyPages[STMEMORY_NUM_PAGES];
+
 /* TODO: when Hatari will support TT/fast-RAM, take it into account
  * in STRAM_ADDR() and STMemory_ValidArea().
  */
@@ -57,6 +66,32 @@ static inline bool STMemory_ValidArea(Uint32 addr, int size)
 }
 
 
+/**
+ * Mark the page of given ST address as modified.
+ */
+static inline void STMemory_SetDirty(Uint32 Address)
+{
+	STMemory_DirtyPages[(Address & 0xffffff) >> STMEMORY_PAGE_SHIFT] = 1;
+}
+
+
+/**
+ * Mark all the pages of given ST memory area as modified.
+ */
+static inline void STMemory_SetDirtyArea(Uint32 Address, Uint32 Size)
+{
+	Uint32 nPage, nLast;
+
+	if (Size == 0)
+		return;
+	nPage = (Address & 0xffffff) >> STMEMORY_PAGE_SHIFT;
+	nLast = ((Address + Size - 1) & 0xffffff) >> STMEMORY_PAGE_SHIFT;
+	if (nLast < nPage)
+		nLast = STMEMORY_NUM_PAGES - 1;
+	memset(&STMemory_DirtyPages[nPage], 1, nLast - nPage + 1);
+}
+
+
 /**
  * Write 32-bit word into ST memory space.
  * NOTE - value will be convert to 68000 endian
@@ -64,6 +99,8 @@ static inline bool STMemory_ValidArea(Uint32 addr, int size)
 static inline void STMemory_WriteLong(Uint32 Address, Uint32 Var)
 {
 	Address &= 0xffffff;
+	STMemory_SetDirty(Address);
+	STMemory_SetDirty(Address+3);
 #if ENABLE_SMALL_MEM
 	if (Address >= 0xe00000)
 		do_put_mem_long(&ROMmemory[Address-0xe00000], Var);
@@ -82,6 +119,8 @@ static inline void STMemory_WriteLong(Uint32 Address, Uint32 Var)
 static inline void STMemory_WriteWord(Uint32 Address, Uint16 Var)
 {
 	Address &= 0xffffff;
+	STMemory_SetDirty(Address);
+	STMemory_SetDirty(Address+1);
 #if ENABLE_SMALL_MEM
 	if (Address >= 0xe00000)
 		do_put_mem_word(&ROMmemory[Address-0xe00000], Var);
@@ -99,6 +138,7 @@ static inline void STMemory_WriteWord(Uint32 Address, Uint16 Var)
 static inline void STMemory_WriteByte(Uint32 Address, Uint8 Var)
 {
 	Address &= 0xffffff;
+	STMemory_SetDirty(Address);
 #if ENABLE_SMALL_MEM
 	if (Address >= 0xe00000)
 		ROMmemory[Address-0xe00000] = Var;
@@ -165,6 +205,8 @@ static inline Uint8 STMemory_ReadByte(Uint32 Address)
 
 extern bool STMemory_SafeCopy(Uint32 addr, Uint8 *src, unsigned int len, const char *name);
 extern void STMemory_MemorySnapShot_Capture(bool bSave);
+extern bool STMemory_UpdateKeyFrame(void);
+extern void STMemory_MemorySnapShot_CaptureCheckpoint(bool bSave);
 extern void STMemory_SetDefaultConfig(void);
 
 #endif
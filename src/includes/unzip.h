@@ -97,6 +97,14 @@ typedef struct unz_global_info_s
 } unz_global_info;
 
 
+/* unz_file_pos is the position of a file in the central dir, see unzGetFilePos */
+typedef struct unz_file_pos_s
+{
+	uLong pos_in_zip_directory;     /* offset in zip file directory */
+	uLong num_of_file;              /* # of file */
+} unz_file_pos;
+
+
 /* unz_file_info contain information about a file in the zipfile */
 typedef struct unz_file_info_s
 {
@@ -196,6 +204,14 @@ extern int ZEXPORT unzLocateFile (unzFile file,
   UNZ_END_OF_LIST_OF_FILE if the file is not found
 */
 
+extern int ZEXPORT unzGetFilePos (unzFile file, unz_file_pos *file_pos);
+extern int ZEXPORT unzGoToFilePos (unzFile file, const unz_file_pos *file_pos);
+/*
+  Store the position of the current file in the central dir, and make
+  a stored position the current file again, without a search by name.
+  return UNZ_OK if there is no problem
+*/
+
 
 extern int ZEXPORT unzGetCurrentFileInfo (unzFile file,
 					  unz_file_info *pfile_info,
@@ -113,6 +113,7 @@
 extern int STRes;
 extern int TTRes;
 extern int nFrameSkips;
+extern bool bSkipVideoFrame;
 extern bool bUseHighRes;
 extern int nVBLs;
 extern int nHBL;
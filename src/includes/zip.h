@@ -24,6 +24,7 @@ extern zip_dir *ZIP_GetFiles(const char *pszFileName);
 extern Uint8 *ZIP_ReadDisk(int Drive, const char *pszFileName, const char *pszZipPath, long *pImageSize, int *pImageType);
 extern bool ZIP_WriteDisk(int Drive, const char *pszFileName, unsigned char *pBuffer, int ImageSize);
 extern Uint8 *ZIP_ReadFirstFile(const char *pszFileName, long *pImageSize, const char * const ppszExts[]);
+extern void ZIP_UnInit(void);
 
 
 #endif  /* HATARI_ZIP_H */
@@ -400,6 +400,31 @@ void M68000_MemorySnapShot_Capture(bool bSave)
 }
 
 
+/*-----------------------------------------------------------------------*/
+/**
+ * Save/Restore the CPU for a checkpoint : in addition to the registers
+ * saved in snapshots, keep the pending special flags and the state used
+ * to compute the timings of the next instructions, as a checkpoint is
+ * expected to give exactly the same emulation when it's restored.
+ */
+void M68000_MemorySnapShot_CaptureCheckpoint(bool bSave)
+{
+	M68000_MemorySnapShot_Capture(bSave);
+
+	MemorySnapShot_Store(&regs.spcflags, sizeof(regs.spcflags));
+	MemorySnapShot_Store(&regs.intmask, sizeof(regs.intmask));
+	MemorySnapShot_Store(&LastOpcodeFamily, sizeof(LastOpcodeFamily));
+	MemorySnapShot_Store(&LastInstrCycles, sizeof(LastInstrCycles));
+	MemorySnapShot_Store(&Pairing, sizeof(Pairing));
+	MemorySnapShot_Store(&BusCyclePenalty, sizeof(BusCyclePenalty));
+	MemorySnapShot_Store(&OpcodeFamily, sizeof(OpcodeFamily));
+	MemorySnapShot_Store(&nWaitStateCycles, sizeof(nWaitStateCycles));
+	MemorySnapShot_Store(&BusMode, sizeof(BusMode));
+	MemorySnapShot_Store(&CPU_IACK, sizeof(CPU_IACK));
+	MemorySnapShot_Store(&CpuInstruction, sizeof(CpuInstruction));
+}
+
+
 /*-----------------------------------------------------------------------*/
 /**
  * BUSERROR - Access outside valid memory range.
@@ -512,6 +512,7 @@ void Main_EventHandler(void)
 #ifdef __LIBRETRO__
 if (ConfigureParams.Sound.bEnableSound)SND=1;
 else SND=-1;
+update_input_late();
 #else
 	bool bContinueProcessing;
 	SDL_Event event;
@@ -894,6 +895,8 @@ int main(int argc, char *argv[])
 	// After initial configuration was loaded
 	// Set tos.img in retro_system_dir
 	snprintf(ConfigureParams.Rom.szTosImageFileName, FILENAME_MAX, "%s", RETRO_TOS);
+	// Audio rate core option, sound stays on or off as configured
+	ConfigureParams.Sound.nPlaybackFreq = atoi(hatari_audio_rate);
 #endif
 
 	/* monitor type option might require "reset" -> true */
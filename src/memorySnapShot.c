@@ -55,7 +55,7 @@ const char MemorySnapShot_fileid[] = "Hatari memorySnapShot.c : " __DATE__ " " _
 #include "statusbar.h"
 
 
-#define VERSION_STRING      "1.8.1"   /* Version number of compatible memory snapshots - Always 6 bytes (inc' NULL) */
+#define VERSION_STRING      "1.8.2"   /* Version number of compatible memory snapshots - Always 6 bytes (inc' NULL) */
 #define SNAPSHOT_MAGIC      0xDeadBeef
 
 #if HAVE_LIBZ
@@ -79,6 +79,103 @@ typedef FILE* MSS_File;
 static MSS_File CaptureFile;
 static bool bCaptureSave, bCaptureError;
 
+/* In-memory snapshot stream, used instead of CaptureFile when bActive is set.
+ * When saving with a NULL pDst, data is only counted to get the snapshot size.
+ */
+static struct
+{
+	bool bActive;
+	Uint8 *pDst;
+	const Uint8 *pSrc;
+	size_t nSize;
+	size_t nPos;
+} CaptureMem;
+
+/* Snapshot sections, in save/restore order */
+typedef struct
+{
+	char sId[4];
+	void (*pCapture)(bool bSave);
+	bool bVariable;		/* size can change at run-time, reserve extra space */
+	void (*pCaptureCheckpoint)(bool bSave);	/* used in checkpoints, NULL if not part of them */
+} MSS_SECTION;
+
+static const MSS_SECTION MemorySnapShot_Sections[] =
+{
+	{ "CONF", Configuration_MemorySnapShot_Capture, false, NULL },
+	{ "TOS ", TOS_MemorySnapShot_Capture, false, NULL },
+	{ "STRA", STMemory_MemorySnapShot_Capture, false, STMemory_MemorySnapShot_CaptureCheckpoint },
+	{ "CYCL", Cycles_MemorySnapShot_Capture, false, Cycles_MemorySnapShot_Capture },	/* Before fdc (for CyclesGlobalClockCounter) */
+	{ "FDC ", FDC_MemorySnapShot_Capture, false, FDC_MemorySnapShot_Capture },
+	{ "FLOP", Floppy_MemorySnapShot_Capture, true, Floppy_MemorySnapShot_CaptureCheckpoint },
+	{ "IPF ", IPF_MemorySnapShot_Capture, false, IPF_MemorySnapShot_Capture },	/* After fdc/floppy, as IPF depends on them */
+	{ "STX ", STX_MemorySnapShot_Capture, true, STX_MemorySnapShot_CaptureCheckpoint },	/* After fdc/floppy, as STX depends on them */
+	{ "GDOS", GemDOS_MemorySnapShot_Capture, false, GemDOS_MemorySnapShot_CaptureCheckpoint },
+	{ "ACIA", ACIA_MemorySnapShot_Capture, false, ACIA_MemorySnapShot_Capture },
+	{ "IKBD", IKBD_MemorySnapShot_Capture, false, IKBD_MemorySnapShot_Capture },	/* After ACIA */
+	{ "CINT", CycInt_MemorySnapShot_Capture, false, CycInt_MemorySnapShot_Capture },
+	{ "M68K", M68000_MemorySnapShot_Capture, false, M68000_MemorySnapShot_CaptureCheckpoint },
+	{ "MFP ", MFP_MemorySnapShot_Capture, false, MFP_MemorySnapShot_Capture },
+	{ "PSG ", PSG_MemorySnapShot_Capture, false, PSG_MemorySnapShot_Capture },
+	{ "SND ", Sound_MemorySnapShot_Capture, false, Sound_MemorySnapShot_CaptureCheckpoint },
+	{ "VID ", Video_MemorySnapShot_Capture, false, Video_MemorySnapShot_Capture },
+	{ "BLIT", Blitter_MemorySnapShot_Capture, false, Blitter_MemorySnapShot_Capture },
+	{ "DMAS", DmaSnd_MemorySnapShot_Capture, false, DmaSnd_MemorySnapShot_CaptureCheckpoint },
+	{ "XBAR", Crossbar_MemorySnapShot_Capture, false, Crossbar_MemorySnapShot_Capture },
+	{ "VIDL", VIDEL_MemorySnapShot_Capture, false, VIDEL_MemorySnapShot_Capture },
+	{ "DSP ", DSP_MemorySnapShot_Capture, false, DSP_MemorySnapShot_Capture },
+	{ "IOME", IoMem_MemorySnapShot_Capture, false, IoMem_MemorySnapShot_Capture },
+};
+
+#define MSS_NUM_SECTIONS	ARRAYSIZE(MemorySnapShot_Sections)
+#define MSS_RESET_SECTION	1	/* Emulator is reset after restoring TOS section */
+
+/* Fixed layout of in-memory snapshots (savestates for rewind/run-ahead):
+ * header, section table and version strings, followed by the sections.
+ * Each section starts at its own offset and has a fixed capacity, so the
+ * total size doesn't vary from one snapshot to another.
+ */
+#define MSS_LAYOUT_MAGIC	"HMSS"
+#define MSS_LAYOUT_VERSION	1
+#define MSS_ALIGN		16
+#define MSS_VARIABLE_GRANULE	(1024*1024)
+
+typedef struct
+{
+	char sMagic[4];
+	Uint32 nVersion;
+	Uint32 nSections;
+	Uint32 nTotalSize;
+} MSS_LAYOUT_HEADER;
+
+typedef struct
+{
+	char sId[4];
+	Uint32 nOffset;
+	Uint32 nSize;		/* bytes used by the section data */
+	Uint32 nCapacity;	/* bytes reserved for the section */
+} MSS_LAYOUT_SECTION;
+
+typedef struct
+{
+	MSS_LAYOUT_HEADER Header;
+	MSS_LAYOUT_SECTION Sections[MSS_NUM_SECTIONS];
+} MSS_LAYOUT;
+
+#define MSS_HEADER_SIZE		sizeof(MSS_LAYOUT)
+/* header is followed by version string and CPU core version */
+#define MSS_DATA_OFFSET		((MSS_HEADER_SIZE + sizeof(VERSION_STRING) + 1 + MSS_ALIGN - 1) & ~(MSS_ALIGN - 1))
+
+static MSS_LAYOUT MemLayout;
+
+static Uint32 nKeyFrame;		/* id of current key frame, 0 if none */
+static Uint32 nLastKeyFrame;
+
+/* Checkpoints only contain the sections that can be restored without
+ * resetting the emulator, their ST memory is the current key frame.
+ */
+#define MSS_CHECKPOINT_MAGIC	"HMSC"
+
 
 /*-----------------------------------------------------------------------*/
 /**
@@ -152,10 +249,60 @@ static int MemorySnapShot_fseek(MSS_File fhndl, int pos)
 
 /*-----------------------------------------------------------------------*/
 /**
- * Open/Create snapshot file, and set flag so 'MemorySnapShot_Store' knows
- * how to handle data.
+ * Read from memory stream.
  */
-static bool MemorySnapShot_OpenFile(const char *pszFileName, bool bSave)
+static int MemorySnapShot_mread(char *buf, int len)
+{
+	if (len < 0 || CaptureMem.nPos + len > CaptureMem.nSize)
+		return -1;
+	memcpy(buf, CaptureMem.pSrc + CaptureMem.nPos, len);
+	CaptureMem.nPos += len;
+	return len;
+}
+
+
+/*-----------------------------------------------------------------------*/
+/**
+ * Write data to memory stream (or only count it if there's no buffer).
+ */
+static int MemorySnapShot_mwrite(const char *buf, int len)
+{
+	if (len < 0)
+		return -1;
+	if (CaptureMem.pDst)
+	{
+		if (CaptureMem.nPos + len > CaptureMem.nSize)
+			return -1;
+		memcpy(CaptureMem.pDst + CaptureMem.nPos, buf, len);
+	}
+	CaptureMem.nPos += len;
+	return len;
+}
+
+
+/*-----------------------------------------------------------------------*/
+/**
+ * Seek into memory stream from current position
+ */
+static int MemorySnapShot_mseek(int pos)
+{
+	if (pos < 0 && (size_t)-pos > CaptureMem.nPos)
+		return -1;
+	/* only a sizing pass may go past the end */
+	if (CaptureMem.nPos + pos > CaptureMem.nSize
+	    && (!bCaptureSave || CaptureMem.pDst))
+		return -1;
+	CaptureMem.nPos += pos;
+	return 0;
+}
+
+
+/*-----------------------------------------------------------------------*/
+/**
+ * Save/check snapshot version string and CPU core version.
+ * Return false if restored values don't match this Hatari version.
+ */
+static bool MemorySnapShot_StoreHeader(void)
 {
 	char VersionString[] = VERSION_STRING;
 #if ENABLE_WINUAE_CPU
@@ -163,8 +310,43 @@ static bool MemorySnapShot_OpenFile(const char *pszFileName, bool bSave)
 #else
 # define CORE_VERSION 0
 #endif
-	Uint8 CpuCore;
+	Uint8 CpuCore = CORE_VERSION;
 
+	/* Save/Restore version string */
+	MemorySnapShot_Store(VersionString, sizeof(VersionString));
+	/* Does match current version? */
+	if (!bCaptureSave && strcmp(VersionString, VERSION_STRING))
+	{
+		/* No, inform user and error */
+		Log_AlertDlg(LOG_ERROR,
+			     "Unable to restore Hatari memory state.\n"
+			     "Given state file is compatible only with\n"
+			     "Hatari version " VERSION_STRING ".");
+		bCaptureError = true;
+		return false;
+	}
+	/* Save/Check CPU core version */
+	MemorySnapShot_Store(&CpuCore, sizeof(CpuCore));
+	if (!bCaptureSave && CpuCore != CORE_VERSION)
+	{
+		Log_AlertDlg(LOG_ERROR,
+			     "Unable to restore Hatari memory state.\n"
+			     "Given state file is for different Hatari\n"
+			     "CPU core version.");
+		bCaptureError = true;
+		return false;
+	}
+	return true;
+}
+
+
+/*-----------------------------------------------------------------------*/
+/**
+ * Open/Create snapshot file, and set flag so 'MemorySnapShot_Store' knows
+ * how to handle data.
+ */
+static bool MemorySnapShot_OpenFile(const char *pszFileName, bool bSave)
+{
 	/* Set error */
 	bCaptureError = false;
 
@@ -186,11 +368,6 @@ static bool MemorySnapShot_OpenFile(const char *pszFileName, bool bSave)
 			return false;
 		}
 		bCaptureSave = true;
-		/* Store version string */
-		MemorySnapShot_Store(VersionString, sizeof(VersionString));
-		/* Store CPU core version */
-		CpuCore = CORE_VERSION;
-		MemorySnapShot_Store(&CpuCore, sizeof(CpuCore));
 	}
 	else
 	{
@@ -204,30 +381,13 @@ static bool MemorySnapShot_OpenFile(const char *pszFileName, bool bSave)
 			return false;
 		}
 		bCaptureSave = false;
-		/* Restore version string */
-		MemorySnapShot_Store(VersionString, sizeof(VersionString));
-		/* Does match current version? */
-		if (strcmp(VersionString, VERSION_STRING))
-		{
-			/* No, inform user and error */
-			Log_AlertDlg(LOG_ERROR,
-				     "Unable to restore Hatari memory state.\n"
-				     "Given state file is compatible only with\n"
-				     "Hatari version " VERSION_STRING ".");
-			bCaptureError = true;
-			return false;
-		}
-		/* Check CPU core version */
-		MemorySnapShot_Store(&CpuCore, sizeof(CpuCore));
-		if (CpuCore != CORE_VERSION)
-		{
-			Log_AlertDlg(LOG_ERROR,
-				     "Unable to restore Hatari memory state.\n"
-				     "Given state file is for different Hatari\n"
-				     "CPU core version.");
-			bCaptureError = true;
-			return false;
-		}
+	}
+
+	/* Store/check version strings */
+	if (!MemorySnapShot_StoreHeader())
+	{
+		MemorySnapShot_fclose(CaptureFile);
+		return false;
 	}
 
 	/* All OK */
@@ -253,8 +413,13 @@ void MemorySnapShot_Skip(int Nb)
 {
 	int res;
 
+	if (CaptureMem.bActive)
+	{
+		if (MemorySnapShot_mseek(Nb) < 0)
+			bCaptureError = true;
+	}
 	/* Check no file errors */
-	if (CaptureFile != NULL)
+	else if (CaptureFile != NULL)
 	{
 		res = MemorySnapShot_fseek(CaptureFile, Nb);
 
@@ -273,8 +438,18 @@ void MemorySnapShot_Store(void *pData, int Size)
 {
 	long nBytes;
 
+	if (CaptureMem.bActive)
+	{
+		if (bCaptureSave)
+			nBytes = MemorySnapShot_mwrite((char *)pData, Size);
+		else
+			nBytes = MemorySnapShot_mread((char *)pData, Size);
+
+		if (nBytes != Size)
+			bCaptureError = true;
+	}
 	/* Check no file errors */
-	if (CaptureFile != NULL)
+	else if (CaptureFile != NULL)
 	{
 		/* Saving or Restoring? */
 		if (bCaptureSave)
@@ -291,42 +466,49 @@ void MemorySnapShot_Store(void *pData, int Size)
 
 /*-----------------------------------------------------------------------*/
 /**
- * Save 'snapshot' of memory/chips/emulation variables
+ * Save/Restore each file's details, in the order given by the sections
+ * table. When restoring, the emulator is reset once the configuration
+ * and TOS have been restored. pszFileName is used for the debugger
+ * breakpoints file, NULL skips it.
  */
-void MemorySnapShot_Capture(const char *pszFileName, bool bConfirm)
+static void MemorySnapShot_StoreSections(const char *pszFileName, bool bSave)
 {
 	Uint32 magic = SNAPSHOT_MAGIC;
+	int i;
+
+	for (i = 0; i < MSS_NUM_SECTIONS; i++)
+	{
+		MemorySnapShot_Sections[i].pCapture(bSave);
+		if (!bSave && i == MSS_RESET_SECTION)
+		{
+			/* Reset emulator to get things running */
+			IoMem_UnInit();  IoMem_Init();
+			Reset_Cold();
+		}
+	}
+	if (pszFileName)
+		DebugUI_MemorySnapShot_Capture(pszFileName, bSave);
 
+	/* version string check catches release-to-release
+	 * state changes, bCaptureError catches too short
+	 * state file, this check a too long state file.
+	 */
+	MemorySnapShot_Store(&magic, sizeof(magic));
+	if (!bSave && !bCaptureError && magic != SNAPSHOT_MAGIC)
+		bCaptureError = true;
+}
+
+
+/*-----------------------------------------------------------------------*/
+/**
+ * Save 'snapshot' of memory/chips/emulation variables
+ */
+void MemorySnapShot_Capture(const char *pszFileName, bool bConfirm)
+{
 	/* Set to 'saving' */
 	if (MemorySnapShot_OpenFile(pszFileName, true))
 	{
-		/* Capture each files details */
-		Configuration_MemorySnapShot_Capture(true);
-		TOS_MemorySnapShot_Capture(true);
-		STMemory_MemorySnapShot_Capture(true);
-		Cycles_MemorySnapShot_Capture(true);			/* Before fdc (for CyclesGlobalClockCounter) */
-		FDC_MemorySnapShot_Capture(true);
-		Floppy_MemorySnapShot_Capture(true);
-		IPF_MemorySnapShot_Capture(true);			/* After fdc/floppy are saved */
-		STX_MemorySnapShot_Capture(true);			/* After fdc/floppy are saved */
-		GemDOS_MemorySnapShot_Capture(true);
-		ACIA_MemorySnapShot_Capture(true);
-		IKBD_MemorySnapShot_Capture(true);
-		CycInt_MemorySnapShot_Capture(true);
-		M68000_MemorySnapShot_Capture(true);
-		MFP_MemorySnapShot_Capture(true);
-		PSG_MemorySnapShot_Capture(true);
-		Sound_MemorySnapShot_Capture(true);
-		Video_MemorySnapShot_Capture(true);
-		Blitter_MemorySnapShot_Capture(true);
-		DmaSnd_MemorySnapShot_Capture(true);
-		Crossbar_MemorySnapShot_Capture(true);
-		VIDEL_MemorySnapShot_Capture(true);
-		DSP_MemorySnapShot_Capture(true);
-		DebugUI_MemorySnapShot_Capture(pszFileName, true);
-		IoMem_MemorySnapShot_Capture(true);
-		/* end marker */
-		MemorySnapShot_Store(&magic, sizeof(magic));
+		MemorySnapShot_StoreSections(pszFileName, true);
 		/* And close */
 		MemorySnapShot_CloseFile();
 	} else {
@@ -349,49 +531,11 @@ void MemorySnapShot_Capture(const char *pszFileName, bool bConfirm)
  */
 void MemorySnapShot_Restore(const char *pszFileName, bool bConfirm)
 {
-	Uint32 magic;
-
 	/* Set to 'restore' */
 	if (MemorySnapShot_OpenFile(pszFileName, false))
 	{
-		Configuration_MemorySnapShot_Capture(false);
-		TOS_MemorySnapShot_Capture(false);
-
-		/* Reset emulator to get things running */
-		IoMem_UnInit();  IoMem_Init();
-		Reset_Cold();
-
-		/* Capture each files details */
-		STMemory_MemorySnapShot_Capture(false);
-		Cycles_MemorySnapShot_Capture(false);			/* Before fdc (for CyclesGlobalClockCounter) */
-		FDC_MemorySnapShot_Capture(false);
-		Floppy_MemorySnapShot_Capture(false);
-		IPF_MemorySnapShot_Capture(false);			/* After fdc/floppy are restored, as IPF depends on them */
-		STX_MemorySnapShot_Capture(false);			/* After fdc/floppy are restored, as STX depends on them */
-		GemDOS_MemorySnapShot_Capture(false);
-		ACIA_MemorySnapShot_Capture(false);
-		IKBD_MemorySnapShot_Capture(false);			/* After ACIA */
-		CycInt_MemorySnapShot_Capture(false);
-		M68000_MemorySnapShot_Capture(false);
-		MFP_MemorySnapShot_Capture(false);
-		PSG_MemorySnapShot_Capture(false);
-		Sound_MemorySnapShot_Capture(false);
-		Video_MemorySnapShot_Capture(false);
-		Blitter_MemorySnapShot_Capture(false);
-		DmaSnd_MemorySnapShot_Capture(false);
-		Crossbar_MemorySnapShot_Capture(false);
-		VIDEL_MemorySnapShot_Capture(false);
-		DSP_MemorySnapShot_Capture(false);
-		DebugUI_MemorySnapShot_Capture(pszFileName, false);
-		IoMem_MemorySnapShot_Capture(false);
-
-		/* version string check catches release-to-release
-		 * state changes, bCaptureError catches too short
-		 * state file, this check a too long state file.
-		 */
-		MemorySnapShot_Store(&magic, sizeof(magic));
-		if (!bCaptureError && magic != SNAPSHOT_MAGIC)
-			bCaptureError = true;
+		MemorySnapShot_StoreSections(pszFileName, false);
+		nKeyFrame = 0;
 
 		/* And close */
 		MemorySnapShot_CloseFile();
@@ -414,6 +558,342 @@ void MemorySnapShot_Restore(const char *pszFileName, bool bConfirm)
 }
 
 
+/*-----------------------------------------------------------------------*/
+/**
+ * Compute the fixed layout of in-memory snapshots: the size each section
+ * needs right now is counted, and rounded up to get its capacity. Capacities
+ * of a previous layout are kept as long as the sections still fit in them,
+ * so the snapshot size stays the same for a given machine configuration.
+ */
+static void MemorySnapShot_UpdateLayout(void)
+{
+	Uint32 nOffset, nUsed, nGranule;
+	int i;
+
+	CaptureMem.bActive = true;
+	CaptureMem.pDst = NULL;
+	CaptureMem.nSize = 0;
+	bCaptureSave = true;
+
+	nOffset = MSS_DATA_OFFSET;
+	for (i = 0; i < MSS_NUM_SECTIONS; i++)
+	{
+		CaptureMem.nPos = 0;
+		MemorySnapShot_Sections[i].pCapture(true);
+		nUsed = CaptureMem.nPos;
+
+		nGranule = MemorySnapShot_Sections[i].bVariable ? MSS_VARIABLE_GRANULE : MSS_ALIGN;
+		if (nUsed > MemLayout.Sections[i].nCapacity)
+			MemLayout.Sections[i].nCapacity = (nUsed + nGranule - 1) & ~(nGranule - 1);
+		memcpy(MemLayout.Sections[i].sId, MemorySnapShot_Sections[i].sId, 4);
+		MemLayout.Sections[i].nOffset = nOffset;
+		nOffset += MemLayout.Sections[i].nCapacity;
+	}
+
+	CaptureMem.bActive = false;
+
+	memcpy(MemLayout.Header.sMagic, MSS_LAYOUT_MAGIC, 4);
+	MemLayout.Header.nVersion = MSS_LAYOUT_VERSION;
+	MemLayout.Header.nSections = MSS_NUM_SECTIONS;
+	MemLayout.Header.nTotalSize = nOffset;
+}
+
+
+/*-----------------------------------------------------------------------*/
+/**
+ * Return the size of in-memory snapshots for the current machine
+ * configuration. It changes only if some section (e.g. floppy image
+ * data) outgrows the space reserved for it.
+ */
+size_t MemorySnapShot_GetMemorySize(void)
+{
+	if (MemLayout.Header.nTotalSize == 0)
+		MemorySnapShot_UpdateLayout();
+	return MemLayout.Header.nTotalSize;
+}
+
+
+/*-----------------------------------------------------------------------*/
+/**
+ * Save 'snapshot' of memory/chips/emulation variables into a memory buffer
+ * of nBufSize bytes, using the fixed layout: a header, a section table,
+ * the version strings and then each section at its own offset, padded
+ * with zeros up to its capacity. Snapshots in memory are never compressed
+ * and don't include the debugger breakpoints.
+ * Return snapshot size in bytes, or 0 on error (e.g. buffer too small).
+ */
+size_t MemorySnapShot_CaptureMemory(void *pBuffer, size_t nBufSize)
+{
+	Uint32 nSize;
+	int i;
+
+	nSize = MemorySnapShot_GetMemorySize();
+	if (pBuffer == NULL || nBufSize < nSize)
+		return 0;
+
+	CaptureMem.bActive = true;
+	CaptureMem.pDst = pBuffer;
+	CaptureMem.pSrc = NULL;
+	CaptureMem.nSize = nSize;
+	CaptureMem.nPos = MSS_HEADER_SIZE;
+	bCaptureSave = true;
+	bCaptureError = false;
+
+	MemorySnapShot_StoreHeader();
+
+	for (i = 0; i < MSS_NUM_SECTIONS && !bCaptureError; i++)
+	{
+		CaptureMem.nPos = MemLayout.Sections[i].nOffset;
+		CaptureMem.nSize = CaptureMem.nPos + MemLayout.Sections[i].nCapacity;
+		MemorySnapShot_Sections[i].pCapture(true);
+		MemLayout.Sections[i].nSize = CaptureMem.nPos - MemLayout.Sections[i].nOffset;
+		memset(CaptureMem.pDst + CaptureMem.nPos, 0, CaptureMem.nSize - CaptureMem.nPos);
+	}
+
+	CaptureMem.bActive = false;
+
+	if (bCaptureError)
+	{
+		/* some section outgrew its space, caller needs to get new size */
+		MemLayout.Header.nTotalSize = 0;
+		return 0;
+	}
+
+	memcpy(pBuffer, &MemLayout, MSS_HEADER_SIZE);
+	return nSize;
+}
+
+
+/*-----------------------------------------------------------------------*/
+/**
+ * Return the id for a new key frame.
+ */
+static Uint32 MemorySnapShot_NewKeyFrameId(void)
+{
+	/* ids from an earlier run shouldn't match the new ones */
+	if (nLastKeyFrame == 0)
+		nLastKeyFrame = (Uint32)time(NULL);
+	if (++nLastKeyFrame == 0)
+		nLastKeyFrame = 1;
+	return nLastKeyFrame;
+}
+
+
+/*-----------------------------------------------------------------------*/
+/**
+ * Save/Restore the sections that are part of checkpoints.
+ */
+static void MemorySnapShot_StoreCheckpoint(bool bSave)
+{
+	Uint32 magic = SNAPSHOT_MAGIC;
+	int i;
+
+	for (i = 0; i < MSS_NUM_SECTIONS; i++)
+	{
+		if (MemorySnapShot_Sections[i].pCaptureCheckpoint)
+			MemorySnapShot_Sections[i].pCaptureCheckpoint(bSave);
+	}
+
+	MemorySnapShot_Store(&magic, sizeof(magic));
+	if (!bSave && !bCaptureError && magic != SNAPSHOT_MAGIC)
+		bCaptureError = true;
+}
+
+
+/*-----------------------------------------------------------------------*/
+/**
+ * Return the number of bytes needed by a checkpoint of the current state.
+ */
+size_t MemorySnapShot_GetCheckpointSize(void)
+{
+	char sMagic[4];
+
+	CaptureMem.bActive = true;
+	CaptureMem.pDst = NULL;
+	CaptureMem.pSrc = NULL;
+	CaptureMem.nSize = 0;
+	CaptureMem.nPos = 0;
+	bCaptureSave = true;
+	bCaptureError = false;
+
+	memcpy(sMagic, MSS_CHECKPOINT_MAGIC, 4);
+	MemorySnapShot_Store(sMagic, sizeof(sMagic));
+	MemorySnapShot_Store(&nKeyFrame, sizeof(nKeyFrame));
+	MemorySnapShot_StoreCheckpoint(true);
+
+	CaptureMem.bActive = false;
+
+	return CaptureMem.nPos;
+}
+
+
+/*-----------------------------------------------------------------------*/
+/**
+ * Save a checkpoint, a lightweight in-memory snapshot for going back a few
+ * frames (e.g. for run-ahead). Its ST memory is a new key frame, made by
+ * only copying the pages modified since the previous one. Configuration,
+ * TOS and disk images aren't saved, so it can only be restored by this
+ * same Hatari process as long as these don't change. Host files and
+ * disk images written since the checkpoint aren't restored either.
+ * Return checkpoint size in bytes, or 0 on error (e.g. buffer too small).
+ */
+size_t MemorySnapShot_CaptureCheckpoint(void *pBuffer, size_t nBufSize)
+{
+	char sMagic[4];
+
+	if (pBuffer == NULL)
+		return 0;
+
+	if (!STMemory_UpdateKeyFrame())
+	{
+		nKeyFrame = 0;
+		return 0;
+	}
+	nKeyFrame = MemorySnapShot_NewKeyFrameId();
+
+	CaptureMem.bActive = true;
+	CaptureMem.pDst = pBuffer;
+	CaptureMem.pSrc = NULL;
+	CaptureMem.nSize = nBufSize;
+	CaptureMem.nPos = 0;
+	bCaptureSave = true;
+	bCaptureError = false;
+
+	memcpy(sMagic, MSS_CHECKPOINT_MAGIC, 4);
+	MemorySnapShot_Store(sMagic, sizeof(sMagic));
+	MemorySnapShot_Store(&nKeyFrame, sizeof(nKeyFrame));
+	MemorySnapShot_StoreCheckpoint(true);
+
+	CaptureMem.bActive = false;
+
+	if (bCaptureError)
+		return 0;
+	return CaptureMem.nPos;
+}
+
+
+/*-----------------------------------------------------------------------*/
+/**
+ * Restore a checkpoint saved by MemorySnapShot_CaptureCheckpoint(). It
+ * can only be applied while its key frame is the current one, i.e. the
+ * last checkpoint taken. The emulator isn't reset.
+ * Return true on success.
+ */
+bool MemorySnapShot_RestoreCheckpoint(const void *pBuffer, size_t nBufSize)
+{
+	char sMagic[4];
+	Uint32 nCheckpointKeyFrame = 0;
+
+	CaptureMem.bActive = true;
+	CaptureMem.pDst = NULL;
+	CaptureMem.pSrc = pBuffer;
+	CaptureMem.nSize = nBufSize;
+	CaptureMem.nPos = 0;
+	bCaptureSave = false;
+	bCaptureError = false;
+
+	MemorySnapShot_Store(sMagic, sizeof(sMagic));
+	MemorySnapShot_Store(&nCheckpointKeyFrame, sizeof(nCheckpointKeyFrame));
+	if (bCaptureError || memcmp(sMagic, MSS_CHECKPOINT_MAGIC, 4) != 0
+	    || nKeyFrame == 0 || nCheckpointKeyFrame != nKeyFrame)
+	{
+		CaptureMem.bActive = false;
+		return false;
+	}
+
+	MemorySnapShot_StoreCheckpoint(false);
+
+	CaptureMem.bActive = false;
+
+	if (bCaptureError)
+	{
+		Log_AlertDlg(LOG_ERROR, "Checkpoint restore failed!\nPlease reboot emulation.");
+		nKeyFrame = 0;
+	}
+
+	return !bCaptureError;
+}
+
+
+/*-----------------------------------------------------------------------*/
+/**
+ * Restore 'snapshot' of memory/chips/emulation variables from a memory
+ * buffer filled by MemorySnapShot_CaptureMemory().
+ * Return true on success.
+ */
+bool MemorySnapShot_RestoreMemory(const void *pBuffer, size_t nBufSize)
+{
+	MSS_LAYOUT Layout;
+	Uint32 nEnd;
+	int i;
+
+	if (nBufSize < MSS_HEADER_SIZE)
+		return false;
+	memcpy(&Layout, pBuffer, MSS_HEADER_SIZE);
+	if (memcmp(Layout.Header.sMagic, MSS_LAYOUT_MAGIC, 4) != 0
+	    || Layout.Header.nVersion != MSS_LAYOUT_VERSION
+	    || Layout.Header.nSections != MSS_NUM_SECTIONS
+	    || Layout.Header.nTotalSize > nBufSize)
+	{
+		Log_AlertDlg(LOG_ERROR, "Unable to restore memory state, unknown layout.");
+		return false;
+	}
+	for (i = 0; i < MSS_NUM_SECTIONS; i++)
+	{
+		nEnd = Layout.Sections[i].nOffset + Layout.Sections[i].nCapacity;
+		if (memcmp(Layout.Sections[i].sId, MemorySnapShot_Sections[i].sId, 4) != 0
+		    || Layout.Sections[i].nSize > Layout.Sections[i].nCapacity
+		    || Layout.Sections[i].nOffset < MSS_DATA_OFFSET
+		    || nEnd > Layout.Header.nTotalSize)
+		{
+			Log_AlertDlg(LOG_ERROR, "Unable to restore memory state, bad section table.");
+			return false;
+		}
+	}
+
+	CaptureMem.bActive = true;
+	CaptureMem.pDst = NULL;
+	CaptureMem.pSrc = pBuffer;
+	CaptureMem.nSize = MSS_DATA_OFFSET;
+	CaptureMem.nPos = MSS_HEADER_SIZE;
+	bCaptureSave = false;
+	bCaptureError = false;
+
+	if (MemorySnapShot_StoreHeader())
+	{
+		for (i = 0; i < MSS_NUM_SECTIONS && !bCaptureError; i++)
+		{
+			/* each section must use exactly the bytes it was saved with */
+			CaptureMem.nPos = Layout.Sections[i].nOffset;
+			CaptureMem.nSize = CaptureMem.nPos + Layout.Sections[i].nSize;
+			MemorySnapShot_Sections[i].pCapture(false);
+			if (CaptureMem.nPos != CaptureMem.nSize)
+				bCaptureError = true;
+
+			if (i == MSS_RESET_SECTION)
+			{
+				/* Reset emulator to get things running */
+				IoMem_UnInit();  IoMem_Init();
+				Reset_Cold();
+			}
+		}
+
+		/* changes may affect also info shown in statusbar */
+		Statusbar_UpdateInfo();
+
+		if (bCaptureError)
+			Log_AlertDlg(LOG_ERROR, "Full memory state restore failed!\nPlease reboot emulation.");
+	}
+
+	CaptureMem.bActive = false;
+
+	/* Checkpoints taken before don't match the memory anymore */
+	nKeyFrame = 0;
+
+	return !bCaptureError;
+}
+
+
 /*-----------------------------------------------------------------------*/
 /*
  * Save and restore functions required by the UAE CPU core...
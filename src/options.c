@@ -134,6 +134,7 @@ enum {
 	OPT_MACHINE,		/* system options */
 	OPT_BLITTER,
 	OPT_DSP,
+	OPT_DSPTHREAD,
 	OPT_TIMERD,
 	OPT_FASTBOOT,
 	OPT_RTC,
@@ -250,7 +251,7 @@ static const opt_t HatariOptions[] = {
 	{ OPT_AVIRECORD, NULL, "--avirecord",
 	  NULL, "Start AVI recording" },
 	{ OPT_AVIRECORD_VCODEC, NULL, "--avi-vcodec",
-	  "<x>", "Select avi video codec (x = bmp/png)" },
+	  "<x>", "Select avi video codec (x = bmp/png/zlib)" },
 	{ OPT_AVIRECORD_FPS, NULL, "--avi-fps",
 	  "<x>", "Force avi frame rate (x = 50/60/71/...)" },
 	{ OPT_AVIRECORD_FILE, NULL, "--avi-file",
@@ -364,6 +365,8 @@ static const opt_t HatariOptions[] = {
 	  "<bool>", "Use blitter emulation (ST only)" },
 	{ OPT_DSP,       NULL, "--dsp",
 	  "<x>", "DSP emulation (x = none/dummy/emu, Falcon only)" },
+	{ OPT_DSPTHREAD, NULL, "--dsp-thread",
+	  "<int>", "Run emulated DSP on its own thread, at most <int> cycles late (0 = off)" },
 	{ OPT_TIMERD,    NULL, "--timer-d",
 	  "<bool>", "Patch Timer-D (about doubles ST emulation speed)" },
 	{ OPT_FASTBOOT, NULL, "--fast-boot",
@@ -1103,6 +1106,10 @@ bool Opt_ParseParameters(int argc, const char * const argv[])
 			{
 				ConfigureParams.Video.AviRecordVcodec = AVI_RECORD_VIDEO_CODEC_PNG;
 			}
+			else if (strcasecmp(argv[i], "zlib") == 0)
+			{
+				ConfigureParams.Video.AviRecordVcodec = AVI_RECORD_VIDEO_CODEC_ZLIB;
+			}
 			else
 			{
 				return Opt_ShowError(OPT_AVIRECORD_VCODEC, argv[i], "Unknown video codec");
@@ -1622,6 +1629,16 @@ bool Opt_ParseParameters(int argc, const char * const argv[])
 			bLoadAutoSave = false;
 			break;
 
+		case OPT_DSPTHREAD:
+			i += 1;
+			temp = atoi(argv[i]);
+			if (temp < 0 || temp > 65536)
+			{
+				return Opt_ShowError(OPT_DSPTHREAD, argv[i], "Invalid DSP cycle skew");
+			}
+			ConfigureParams.System.nDSPThreadSkew = temp;
+			break;
+
 			/* sound options */
 		case OPT_YM_MIXING:
 			i += 1;
@@ -87,6 +87,9 @@ static int PCScreenOffsetY;                        /* how many pixels to skip fr
 static SDL_Rect STScreenRect;                      /* screen size without statusbar */
 
 static int STScreenLineOffset[NUM_VISIBLE_LINES];  /* Offsets for ST screen lines eg, 0,160,320... */
+static bool STScreenLineChanged[NUM_VISIBLE_LINES]; /* Lines which differ from previous ST screen */
+static bool bSTScreenLinesCompared;                /* true if above is already set for this frame */
+static int STResDrawn = -1;                        /* Resolution of the last drawn frame */
 static Uint16 HBLPalette[16], PrevHBLPalette[16];  /* Current palette for line, also copy of first line */
 
 static void (*ScreenDrawFunctionsNormal[3])(void); /* Screen draw functions */
@@ -621,6 +624,9 @@ static void Screen_SetResolution(void)
 		
 		/* Zoom if necessary, factors used for scaling mouse motions */
 		if (STRes == ST_LOW_RES &&
+#ifdef __LIBRETRO__
+		    !retro_native_res &&
+#endif
 		    2*Width <= maxW && 2*Height+SBarHeight <= maxH)
 		{
 			nZoom = 2;
@@ -1299,6 +1305,89 @@ static void Screen_Blit(SDL_Rect *sbar_rect)
 }
 
 
+/*-----------------------------------------------------------------------*/
+/**
+ * Compare the ST screen lines the colour converters read with the previous
+ * ST screen, and flag in 'STScreenLineChanged[]' those which differ so that
+ * the converters can skip the others. This uses memcmp(), which the C library
+ * vectorises, instead of the converters' 8 bytes at a time compares.
+ * Return true if any line changed.
+ */
+static bool Screen_CompareLines(void)
+{
+	Uint8 *pScreen = pFrameBuffer->pSTScreen;
+	Uint8 *pCopy = pFrameBuffer->pSTScreenCopy;
+	bool bChanged = false;
+	int y, offset;
+
+	for (y = STScreenStartHorizLine; y < STScreenEndHorizLine; y++)
+	{
+		offset = STScreenLineOffset[y] + STScreenLeftSkipBytes;
+		STScreenLineChanged[y] = memcmp(pScreen + offset, pCopy + offset, STScreenWidthBytes) != 0;
+		bChanged |= STScreenLineChanged[y];
+	}
+
+	bSTScreenLinesCompared = true;
+	return bChanged;
+}
+
+
+/*-----------------------------------------------------------------------*/
+/**
+ * Check if the frame to draw is identical to the previously drawn one:
+ * same resolution, overscan and palettes on every line, and same ST screen
+ * contents. Palettes are checked first, as they are the cheapest to compare.
+ */
+static bool Screen_FrameUnchanged(void)
+{
+	Uint32 mask;
+	int y, i;
+
+	if (pFrameBuffer->bFullUpdate || STRes != STResDrawn
+	    || pFrameBuffer->OverscanModeCopy != OverscanMode)
+		return false;
+
+	if (bUseVDIRes)
+	{
+		if (memcmp(HBLPalettes, PrevHBLPalette, sizeof(Uint16)*16) != 0)
+			return false;
+		return memcmp(pFrameBuffer->pSTScreen, pFrameBuffer->pSTScreenCopy,
+		              VDIHeight * VDIWidth * VDIPlanes / 8) == 0;
+	}
+
+	if (bUseHighRes)
+	{
+		/* See the mono colours in Screen_ComparePaletteMask() */
+		if (((HBLPalettes[0] & 0x777) ? 0x777 : 0x000) != PrevHBLPalette[0])
+			return false;
+		return memcmp(pFrameBuffer->pSTScreen, pFrameBuffer->pSTScreenCopy,
+		              (STScreenEndHorizLine - STScreenStartHorizLine) * SCREENBYTES_MONOLINE) == 0;
+	}
+
+	if (Spec512_IsImage())
+		return false;
+
+	/* The first line sets the whole palette, so if each line writes the
+	 * same colours and resolution as in the previous frame, all the line
+	 * palettes stored in 'pFrameBuffer' are still valid */
+	if ((HBLPaletteMasks[0] & PALETTEMASK_PALETTE) != PALETTEMASK_PALETTE)
+		return false;
+	for (y = 0; y < NUM_VISIBLE_LINES; y++)
+	{
+		mask = HBLPaletteMasks[y] & ~PALETTEMASK_UPDATEMASK;
+		if (mask != (pFrameBuffer->HBLPaletteMasks[y] & ~PALETTEMASK_UPDATEMASK))
+			return false;
+		for (i = 0; (mask & PALETTEMASK_PALETTE) && i < 16; i++)
+		{
+			if ((mask & (1<<i)) && HBLPalettes[y*16+i] != pFrameBuffer->HBLPalettes[y*16+i])
+				return false;
+		}
+	}
+
+	return !Screen_CompareLines();
+}
+
+
 /*-----------------------------------------------------------------------*/
 /**
  * Draw ST screen to window/full-screen framebuffer
@@ -1312,12 +1401,27 @@ static bool Screen_DrawFrame(bool bForceFlip)
 	static bool bPrevFrameWasSpec512 = false;
 	SDL_Rect *sbar_rect;
 
+	bSTScreenLinesCompared = false;
+
+	/* Nothing changed since the previous frame? Then skip palette compare
+	 * and conversion, only the statusbar may need updating */
+	if (!bForceFlip && !bPrevFrameWasSpec512 && Screen_FrameUnchanged())
+	{
+		Statusbar_OverlayRestore(sdlscrn);
+		Statusbar_OverlayBackup(sdlscrn);
+		sbar_rect = Statusbar_Update(sdlscrn, false);
+		if (sbar_rect)
+			Screen_Blit(sbar_rect);
+		return false;
+	}
+
 	/* Scan palette/resolution masks for each line and build up palette/difference tables */
 	new_res = Screen_ComparePaletteMask(STRes);
 	/* Do require palette? Check if changed and update */
 	Screen_Handle8BitPalettes();
 	/* Did we change resolution this frame - allocate new screen if did so */
 	Screen_DidResolutionChange(new_res);
+	STResDrawn = STRes;
 	/* Is need full-update, tag as such */
 	if (pFrameBuffer->bFullUpdate)
 		Screen_SetFullUpdateMask();
@@ -1375,6 +1479,10 @@ static bool Screen_DrawFrame(bool bForceFlip)
 			}
 		}
 
+		/* Find lines to convert, unless already done above */
+		if (!bUseVDIRes && !bUseHighRes && !bPrevFrameWasSpec512 && !bSTScreenLinesCompared)
+			Screen_CompareLines();
+
 		if (pDrawFunction)
 			CALL_VAR(pDrawFunction);
 
@@ -1463,6 +1571,17 @@ static int AdjustLinePaletteRemap(int y)
 	return ScrUpdateFlag;
 }
 
+/*-----------------------------------------------------------------------*/
+/**
+ * Return true if line 'y' needs converting, ie. its palette or resolution
+ * changed ('update' from AdjustLinePaletteRemap()) or its ST data differs
+ * from the previous screen.
+ */
+static inline bool Convert_LineChanged(int y, int update)
+{
+	return (update & PALETTEMASK_UPDATEMASK) || STScreenLineChanged[y];
+}
+
 #ifdef __LIBRETRO__
 void reset_screen(){
 Resolution_Init();
@@ -96,12 +96,45 @@ static int ScreenSnapShot_SavePNG(SDL_Surface *surface, const char *filename)
 }
 
 
+/* Growable buffer receiving the png data in ScreenSnapShot_SavePNG_ToMemory() */
+typedef struct
+{
+	Uint8	*pBuf;
+	int	nSize;
+	int	nAlloc;
+} PNG_MEMBUF;
+
+static void ScreenSnapShot_PNGWriteMem(png_structp png_ptr, png_bytep data, png_size_t length)
+{
+	PNG_MEMBUF *pMem = png_get_io_ptr(png_ptr);
+	Uint8 *pNewBuf;
+	int nNewAlloc;
+
+	if (pMem->nSize + (int)length > pMem->nAlloc)
+	{
+		nNewAlloc = 2 * pMem->nAlloc + length;
+		pNewBuf = realloc(pMem->pBuf, nNewAlloc);
+		if (!pNewBuf)
+			png_error(png_ptr, "out of memory");
+		pMem->pBuf = pNewBuf;
+		pMem->nAlloc = nNewAlloc;
+	}
+	memcpy(pMem->pBuf + pMem->nSize, data, length);
+	pMem->nSize += length;
+}
+
+static void ScreenSnapShot_PNGFlushMem(png_structp png_ptr)
+{
+}
+
+
 /**
- * Save given SDL surface as PNG in an already opened FILE, eventually cropping some borders.
- * Return png file size > 0 for success.
- * This function is also used by avi_record.c to save individual frames as png images.
+ * Save given SDL surface as PNG, either in an already opened FILE
+ * or in a memory buffer, eventually cropping some borders.
+ * Return png size > 0 for success.
  */
-int ScreenSnapShot_SavePNG_ToFile(SDL_Surface *surface, FILE *fp, int png_compression_level, int png_filter ,
+static int ScreenSnapShot_SavePNG_Write(SDL_Surface *surface, FILE *fp, PNG_MEMBUF *pMem,
+		int png_compression_level, int png_filter ,
 		int CropLeft , int CropRight , int CropTop , int CropBottom )
 {
 	bool do_lock;
@@ -137,11 +170,19 @@ int ScreenSnapShot_SavePNG_ToFile(SDL_Surface *surface, FILE *fp, int png_compre
 	if (setjmp(png_jmpbuf(png_ptr)))
 		goto png_cleanup;
 
-	/* store current pos in fp (could be != 0 for avi recording) */
-	start = ftell ( fp );
-
 	/* initialize the png structure */
-	png_init_io(png_ptr, fp);
+	if (fp)
+	{
+		/* store current pos in fp (could be != 0 for avi recording) */
+		start = ftell ( fp );
+		png_init_io(png_ptr, fp);
+	}
+	else
+	{
+		start = 0;
+		pMem->nSize = 0;
+		png_set_write_fn(png_ptr, pMem, ScreenSnapShot_PNGWriteMem, ScreenSnapShot_PNGFlushMem);
+	}
 
 	/* image data properties */
 	png_set_IHDR(png_ptr, info_ptr, w, h, 8, PNG_COLOR_TYPE_RGB,
@@ -199,7 +240,10 @@ int ScreenSnapShot_SavePNG_ToFile(SDL_Surface *surface, FILE *fp, int png_compre
 	/* write the additional chuncks to the PNG file */
 	png_write_end(png_ptr, info_ptr);
 
-	ret = ftell ( fp ) - start;				/* size of the png image */
+	if (fp)
+		ret = ftell ( fp ) - start;			/* size of the png image */
+	else
+		ret = pMem->nSize;
 png_cleanup:
 	if (palette_ptr)
 		free(palette_ptr);
@@ -207,6 +251,43 @@ png_cleanup:
 		png_destroy_write_struct(&png_ptr, NULL);
 	return ret;
 }
+
+
+/**
+ * Save given SDL surface as PNG in an already opened FILE, eventually cropping some borders.
+ * Return png file size > 0 for success.
+ */
+int ScreenSnapShot_SavePNG_ToFile(SDL_Surface *surface, FILE *fp, int png_compression_level, int png_filter ,
+		int CropLeft , int CropRight , int CropTop , int CropBottom )
+{
+	return ScreenSnapShot_SavePNG_Write(surface, fp, NULL, png_compression_level, png_filter,
+					    CropLeft, CropRight, CropTop, CropBottom);
+}
+
+
+/**
+ * Save given SDL surface as PNG in a memory buffer, eventually cropping some borders.
+ * *ppBuf (of *pBufAlloc bytes) is reused and grown with realloc() when needed,
+ * the caller has to free it. Return png size > 0 for success.
+ * This function is used by avi_record.c's encoding threads to compress
+ * individual frames as png images.
+ */
+int ScreenSnapShot_SavePNG_ToMemory(SDL_Surface *surface, Uint8 **ppBuf, int *pBufAlloc,
+		int png_compression_level, int png_filter ,
+		int CropLeft , int CropRight , int CropTop , int CropBottom )
+{
+	PNG_MEMBUF Mem;
+	int ret;
+
+	Mem.pBuf = *ppBuf;
+	Mem.nSize = 0;
+	Mem.nAlloc = *pBufAlloc;
+	ret = ScreenSnapShot_SavePNG_Write(surface, NULL, &Mem, png_compression_level, png_filter,
+					   CropLeft, CropRight, CropTop, CropBottom);
+	*ppBuf = Mem.pBuf;
+	*pBufAlloc = Mem.nAlloc;
+	return ret;
+}
 #endif
 
 
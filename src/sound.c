@@ -259,6 +259,7 @@ static ymu32	Ym2149_ToneStepCompute	(ymu8 rHigh , ymu8 rLow);
 static ymu32	Ym2149_NoiseStepCompute	(ymu8 rNoise);
 static ymu32	Ym2149_EnvStepCompute	(ymu8 rHigh , ymu8 rLow);
 static ymsample	YM2149_NextSample	(void);
+static void	YM2149_DoSamples	(Sint16 (*pBuffer)[2], int nSamples, bool bFilterDC);
 
 static int	Sound_SetSamplesPassed(bool FillFrame);
 static void	Sound_GenerateSamples(int SamplesToGenerate);
@@ -275,27 +276,50 @@ static void	Sound_GenerateSamples(int SamplesToGenerate);
  * a = (int32_t)(32768.0*(1.0 - pole)) :       a = 64 !!!
  * Input range: -32768 to 32767  Maximum step: +65536 or -65472
  */
-ymsample	Subsonic_IIR_HPF_Left(ymsample x0)
+typedef struct
 {
-	static	yms32	x1 = 0, y1 = 0, y0 = 0;
+	yms32	x1, y1, y0;
+} SUBSONIC_HPF;
+
+static SUBSONIC_HPF	HPF_Left, HPF_Right;
 
-	y1 += ((x0 - x1)<<15) - (y0<<6);  /*  64*y0  */
-	y0 = y1>>15;
-	x1 = x0;
+static yms32	LowPass_y0, LowPass_x1;			/* state of LowPassFilter() */
+static yms32	PWMalias_y0, PWMalias_x1;		/* state of PWMaliasFilter() */
 
-	return y0;
+static inline ymsample	Subsonic_IIR_HPF(SUBSONIC_HPF *pFilter, ymsample x0)
+{
+	pFilter->y1 += ((x0 - pFilter->x1)<<15) - (pFilter->y0<<6);  /*  64*y0  */
+	pFilter->y0 = pFilter->y1>>15;
+	pFilter->x1 = x0;
+
+	return pFilter->y0;
+}
+
+
+ymsample	Subsonic_IIR_HPF_Left(ymsample x0)
+{
+	return Subsonic_IIR_HPF(&HPF_Left, x0);
 }
 
 
 ymsample	Subsonic_IIR_HPF_Right(ymsample x0)
 {
-	static	yms32	x1 = 0, y1 = 0, y0 = 0;
+	return Subsonic_IIR_HPF(&HPF_Right, x0);
+}
 
-	y1 += ((x0 - x1)<<15) - (y0<<6);  /*  64*y0  */
-	y0 = y1>>15;
-	x1 = x0;
 
-	return y0;
+/**
+ * Apply the left and right DC filters to a contiguous block of stereo samples
+ */
+void	Subsonic_IIR_HPF_Stereo(Sint16 (*pBuffer)[2], int nSamples)
+{
+	int	i;
+
+	for ( i = 0 ; i < nSamples ; i++ )
+	{
+		pBuffer[i][0] = Subsonic_IIR_HPF(&HPF_Left, pBuffer[i][0]);
+		pBuffer[i][1] = Subsonic_IIR_HPF(&HPF_Right, pBuffer[i][1]);
+	}
 }
 
 
@@ -340,17 +364,15 @@ ymsample	Subsonic_IIR_HPF_Right(ymsample x0)
  */
 static ymsample	LowPassFilter(ymsample x0)
 {
-	static	yms32 y0 = 0, x1 = 0;
-
-	if (x0 >= y0)
+	if (x0 >= LowPass_y0)
 	/* YM Pull up:   fc = 7586.1 Hz (44.1 KHz), fc = 8257.0 Hz (48 KHz) */
-		y0 = (3*(x0 + x1) + (y0<<1)) >> 3;
+		LowPass_y0 = (3*(x0 + LowPass_x1) + (LowPass_y0<<1)) >> 3;
 	else
 	/* R8 Pull down: fc = 1992.0 Hz (44.1 KHz), fc = 2168.0 Hz (48 KHz) */
-		y0 = ((x0 + x1) + (6*y0)) >> 3;
+		LowPass_y0 = ((x0 + LowPass_x1) + (6*LowPass_y0)) >> 3;
 
-	x1 = x0;
-	return y0;
+	LowPass_x1 = x0;
+	return LowPass_y0;
 }
 
 /**
@@ -368,17 +390,15 @@ static ymsample	LowPassFilter(ymsample x0)
  */
 static ymsample	PWMaliasFilter(ymsample x0)
 {
-	static	yms32 y0 = 0, x1 = 0;
-
-	if (x0 >= y0)
+	if (x0 >= PWMalias_y0)
 	/* YM Pull up   */
-		y0 = x0;
+		PWMalias_y0 = x0;
 	else
 	/* R8 Pull down */
-		y0 = (3*(x0 + x1) + (y0<<1)) >> 3;
+		PWMalias_y0 = (3*(x0 + PWMalias_x1) + (PWMalias_y0<<1)) >> 3;
 
-	x1 = x0;
-	return y0;
+	PWMalias_x1 = x0;
+	return PWMalias_y0;
 }
 
 
@@ -972,11 +992,7 @@ static ymsample	YM2149_NextSample(void)
 	if ( envPos >= (3*32) << 24 )			/* blocks 0, 1 and 2 were used (envPos 0 to 95) */
 		envPos -= (2*32) << 24;			/* replay/loop blocks 1 and 2 (envPos 32 to 95) */
 
-	/* Apply low pass filter ? */
-	if ( UseLowPassFilter )
-		return LowPassFilter(sample);
-	else
-		return PWMaliasFilter(sample);
+	return sample;
 }
 #else
 static ymsample	YM2149_NextSample(void)
@@ -1041,13 +1057,44 @@ static ymsample	YM2149_NextSample(void)
 	if ( envPos >= (3*32) << 24 )			/* blocks 0, 1 and 2 were used (envPos 0 to 95) */
 		envPos -= (2*32) << 24;			/* replay/loop blocks 1 and 2 (envPos 32 to 95) */
 
-	/* Apply low pass filter ? */
+	return sample;
+}
+#endif
+
+
+/*-----------------------------------------------------------------------*/
+/**
+ * Generate a block of nSamples YM2149 samples into a contiguous part of
+ * the mix buffer (same value for left and right channels).
+ * The choice of low pass filter and of the optional subsonic DC filter
+ * is made once for the whole block instead of once per sample.
+ */
+static void	YM2149_DoSamples(Sint16 (*pBuffer)[2], int nSamples, bool bFilterDC)
+{
+	ymsample	sample;
+	int		i;
+
 	if ( UseLowPassFilter )
-		return LowPassFilter(sample);
+	{
+		for ( i = 0 ; i < nSamples ; i++ )
+		{
+			sample = LowPassFilter( YM2149_NextSample() );
+			if ( bFilterDC )
+				sample = Subsonic_IIR_HPF( &HPF_Left , sample );
+			pBuffer[i][0] = pBuffer[i][1] = sample;
+		}
+	}
 	else
-		return PWMaliasFilter(sample);
+	{
+		for ( i = 0 ; i < nSamples ; i++ )
+		{
+			sample = PWMaliasFilter( YM2149_NextSample() );
+			if ( bFilterDC )
+				sample = Subsonic_IIR_HPF( &HPF_Left , sample );
+			pBuffer[i][0] = pBuffer[i][1] = sample;
+		}
+	}
 }
-#endif
 
 
 /*-----------------------------------------------------------------------*/
@@ -1297,6 +1344,35 @@ void Sound_MemorySnapShot_Capture(bool bSave)
 }
 
 
+/*-----------------------------------------------------------------------*/
+/**
+ * Save/Restore the sound state for a checkpoint : in addition to the YM
+ * state saved in snapshots, keep the position in the mix buffer and the
+ * filters' state, so the samples generated after restoring a checkpoint
+ * are exactly the same as the first time.
+ */
+void Sound_MemorySnapShot_CaptureCheckpoint(bool bSave)
+{
+	Sound_MemorySnapShot_Capture(bSave);
+
+	MemorySnapShot_Store(&ActiveSndBufIdx, sizeof(ActiveSndBufIdx));
+	MemorySnapShot_Store(&ActiveSndBufIdxAvi, sizeof(ActiveSndBufIdxAvi));
+	MemorySnapShot_Store(&SamplesPerFrame_unrounded, sizeof(SamplesPerFrame_unrounded));
+	MemorySnapShot_Store(&SamplesPerFrame, sizeof(SamplesPerFrame));
+	MemorySnapShot_Store(&CurrentSamplesNb, sizeof(CurrentSamplesNb));
+	MemorySnapShot_Store(&Sound_BufferIndexNeedReset, sizeof(Sound_BufferIndexNeedReset));
+	MemorySnapShot_Store(&HPF_Left, sizeof(HPF_Left));
+	MemorySnapShot_Store(&HPF_Right, sizeof(HPF_Right));
+	MemorySnapShot_Store(&LowPass_y0, sizeof(LowPass_y0));
+	MemorySnapShot_Store(&LowPass_x1, sizeof(LowPass_x1));
+	MemorySnapShot_Store(&PWMalias_y0, sizeof(PWMalias_y0));
+	MemorySnapShot_Store(&PWMalias_x1, sizeof(PWMalias_x1));
+	MemorySnapShot_Store(&nGeneratedSamples, sizeof(nGeneratedSamples));
+	MemorySnapShot_Store(&CompleteSndBufIdx, sizeof(CompleteSndBufIdx));
+	MemorySnapShot_Store(&pulse_swallowing_count, sizeof(pulse_swallowing_count));
+}
+
+
 /*-----------------------------------------------------------------------*/
 /**
  * Find how many samples to generate and store in 'nSamplesToGenerate'
@@ -1367,40 +1443,41 @@ static int Sound_SetSamplesPassed(bool FillFrame)
  */
 static void Sound_GenerateSamples(int SamplesToGenerate)
 {
-	int	i;
-	int	idx;
+	int	idx, n;
+	int	nRemaining;
+	bool	bFilterDC;
 
 	if (SamplesToGenerate <= 0)
 		return;
 
+	/* Ste and TT have their own filtering done by DmaSnd */
+	bFilterDC = ( ConfigureParams.System.nMachineType == MACHINE_ST )
+		|| ( ConfigureParams.System.nMachineType == MACHINE_FALCON );
+
+	/* Generate YM samples in at most 2 contiguous blocks, as the */
+	/* ring buffer can only wrap once for a given call */
+	idx = ActiveSndBufIdx;
+	nRemaining = SamplesToGenerate;
+	while (nRemaining > 0)
+	{
+		n = MIXBUFFER_SIZE - idx;
+		if (n > nRemaining)
+			n = nRemaining;
+		YM2149_DoSamples(&MixBuffer[idx], n, bFilterDC);
+		idx = (idx + n) % MIXBUFFER_SIZE;
+		nRemaining -= n;
+	}
+
 	if (ConfigureParams.System.nMachineType == MACHINE_FALCON)
 	{
-		for (i = 0; i < SamplesToGenerate; i++)
-		{
-			idx = (ActiveSndBufIdx + i) % MIXBUFFER_SIZE;
-			MixBuffer[idx][0] = MixBuffer[idx][1] = Subsonic_IIR_HPF_Left( YM2149_NextSample() );
-		}
  		/* If Falcon emulation, crossbar does the job */
  		Crossbar_GenerateSamples(ActiveSndBufIdx, SamplesToGenerate);
 	}
 	else if (ConfigureParams.System.nMachineType != MACHINE_ST)
 	{
-		for (i = 0; i < SamplesToGenerate; i++)
-		{
-			idx = (ActiveSndBufIdx + i) % MIXBUFFER_SIZE;
-			MixBuffer[idx][0] = MixBuffer[idx][1] = YM2149_NextSample();
-		}
  		/* If Ste or TT emulation, DmaSnd does mixing and filtering */
  		DmaSnd_GenerateSamples(ActiveSndBufIdx, SamplesToGenerate);
 	}
-	else if (ConfigureParams.System.nMachineType == MACHINE_ST)
-	{
-		for (i = 0; i < SamplesToGenerate; i++)
-		{
-			idx = (ActiveSndBufIdx + i) % MIXBUFFER_SIZE;
-			MixBuffer[idx][0] = MixBuffer[idx][1] = Subsonic_IIR_HPF_Left( YM2149_NextSample() );
-		}
- 	}
 
 	ActiveSndBufIdx = (ActiveSndBufIdx + SamplesToGenerate) % MIXBUFFER_SIZE;
 	nGeneratedSamples += SamplesToGenerate;
@@ -1439,12 +1516,17 @@ void Sound_Update(bool FillFrame)
 
 #ifdef __LIBRETRO__
 extern short signed int SNDBUF[1024*2];
+/* Samples of the last complete VBL, as up to 2 parts of the MixBuffer
+ * ring (or as a single part in SNDBUF if they had to be padded) */
+static const Sint16 *pRetroSamples[2];
+static int nRetroSamples[2];
 static void Retro_Audio_CallBack(int len)
 {
 Sint16 *pBuffer;
 int i, window, nSamplesPerFrame;
 pBuffer = (Sint16 *)&SNDBUF[0];
 len = len / 4; // Use length in samples (16 bit stereo), not in bytes
+nRetroSamples[0] = nRetroSamples[1] = 0;
 /* Adjust emulation rate within +/- 0.58% (10 cents) occasionally,
 * to synchronize sound. Note that an octave (frequency doubling)
 * has 12 semitones (12th root of two for a semitone), and that
@@ -1473,19 +1555,23 @@ pulse_swallowing_count = 5793 / nScreenRefreshRate;
 }
 if (nGeneratedSamples >= len)
 {
-/* Enough samples available: Pass completed buffer to audio system
-* by write samples into sound buffer and by converting them from
-* 'signed' to 'unsigned' */
-for (i = 0; i < len; i++)
-{
-*pBuffer++ = MixBuffer[(CompleteSndBufIdx + i) % MIXBUFFER_SIZE][0];
-*pBuffer++ = MixBuffer[(CompleteSndBufIdx + i) % MIXBUFFER_SIZE][1];
-}
+/* Enough samples available: hand them to the frontend straight
+* from the ring buffer, in 2 parts if it wraps around */
+nRetroSamples[0] = MIXBUFFER_SIZE - CompleteSndBufIdx;
+if (nRetroSamples[0] > len)
+nRetroSamples[0] = len;
+pRetroSamples[0] = MixBuffer[CompleteSndBufIdx];
+nRetroSamples[1] = len - nRetroSamples[0];
+pRetroSamples[1] = MixBuffer[0];
 CompleteSndBufIdx += len;
 nGeneratedSamples -= len;
 }
 else /* Not enough samples available: */
 {
+if (len > (int)(sizeof(SNDBUF) / 4))
+len = sizeof(SNDBUF) / 4;
+if (nGeneratedSamples > len)
+nGeneratedSamples = len;
 for (i = 0; i < nGeneratedSamples; i++)
 {
 *pBuffer++ = MixBuffer[(CompleteSndBufIdx + i) % MIXBUFFER_SIZE][0];
@@ -1496,13 +1582,38 @@ for (i = 0; i < nGeneratedSamples; i++)
 if (nGeneratedSamples >= len/2)
 {
 int remaining = len - nGeneratedSamples;
-memcpy(pBuffer, SNDBUF+(nGeneratedSamples-remaining)*4, remaining*4);
+memcpy(pBuffer, &SNDBUF[(nGeneratedSamples-remaining)*2], remaining*4);
 }
+else /* Otherwise pad with silence */
+memset(pBuffer, 0, (len - nGeneratedSamples)*4);
+pRetroSamples[0] = SNDBUF;
+nRetroSamples[0] = len;
 CompleteSndBufIdx += nGeneratedSamples;
 nGeneratedSamples = 0;
 }
 CompleteSndBufIdx = CompleteSndBufIdx % MIXBUFFER_SIZE;
 }
+
+/**
+ * Give the samples of the last complete VBL to the libretro frontend,
+ * as up to 2 buffers of interleaved stereo samples. Samples are only
+ * returned once.
+ * Return the number of buffers.
+ */
+int Sound_GetRetroSamples(const Sint16 **ppSamples, int *pnSamples)
+{
+int i, n = 0;
+for (i = 0; i < 2; i++)
+{
+if (nRetroSamples[i] > 0)
+{
+ppSamples[n] = pRetroSamples[i];
+pnSamples[n++] = nRetroSamples[i];
+}
+nRetroSamples[i] = 0;
+}
+return n;
+}
 #endif
 
 
@@ -1522,7 +1633,6 @@ void Sound_Update_VBL(void)
 //fprintf ( stderr , "vbl done %d %d\n" , SamplesPerFrame , CurrentSamplesNb );
 
 #ifdef __LIBRETRO__
-memset(SNDBUF,0,1024*4);
 Retro_Audio_CallBack(CurrentSamplesNb*4);
 #endif
 
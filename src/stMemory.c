@@ -33,6 +33,16 @@ Uint8 STRam[16*1024*1024];
 
 Uint32 STRamEnd;            /* End of ST Ram, above this address is no-mans-land and ROM/IO memory */
 
+Uint8 STMemory_DirtyPages[STMEMORY_NUM_PAGES];	/* Pages written since the last key frame */
+
+/* Copy of the RAM and of the cart/TOS/hardware area at the last key frame */
+static Uint8 *pKeyFrameRam;
+static Uint32 nKeyFrameRamEnd;
+
+#define ROM_AREA_START	0xE00000
+#define ROM_AREA_SIZE	0x200000
+#define IO_AREA_START	0xFF0000	/* IO registers, written without page tracking */
+
 
 /**
  * Clear section of ST's memory space.
@@ -40,6 +50,7 @@ Uint32 STRamEnd;            /* End of ST Ram, above this address is no-mans-land
 static void STMemory_Clear(Uint32 StartAddress, Uint32 EndAddress)
 {
 	memset(&STRam[StartAddress], 0, EndAddress-StartAddress);
+	STMemory_SetDirtyArea(StartAddress, EndAddress-StartAddress);
 }
 
 /**
@@ -58,6 +69,8 @@ bool STMemory_SafeCopy(Uint32 addr, Uint8 *src, unsigned int len, const char *na
 {
 	Uint32 end;
 
+	STMemory_SetDirtyArea(addr, len);
+
 	if (STMemory_ValidArea(addr, len))
 	{
 		memcpy(&STRam[addr], src, len);
@@ -85,7 +98,120 @@ void STMemory_MemorySnapShot_Capture(bool bSave)
 	MemorySnapShot_Store(STRam, STRamEnd);
 
 	/* And Cart/TOS/Hardware area */
-	MemorySnapShot_Store(&RomMem[0xE00000], 0x200000);
+	MemorySnapShot_Store(&RomMem[ROM_AREA_START], ROM_AREA_SIZE);
+
+	/* All of it may differ from the key frame now */
+	if (!bSave)
+		memset(STMemory_DirtyPages, 1, sizeof(STMemory_DirtyPages));
+}
+
+
+/**
+ * Take a copy of the RAM and ROM area as key frame for the following
+ * checkpoints, and clear the dirty pages.
+ */
+static void STMemory_SetKeyFrame(void)
+{
+	if (!pKeyFrameRam)
+	{
+		pKeyFrameRam = malloc(STRamEnd + ROM_AREA_SIZE);
+		if (!pKeyFrameRam)
+		{
+			perror("STMemory_SetKeyFrame");
+			return;
+		}
+	}
+	else if (nKeyFrameRamEnd != STRamEnd)
+	{
+		Uint8 *pNew = realloc(pKeyFrameRam, STRamEnd + ROM_AREA_SIZE);
+		if (!pNew)
+		{
+			perror("STMemory_SetKeyFrame");
+			return;
+		}
+		pKeyFrameRam = pNew;
+	}
+	nKeyFrameRamEnd = STRamEnd;
+
+	memcpy(pKeyFrameRam, STRam, STRamEnd);
+	memcpy(pKeyFrameRam + STRamEnd, &RomMem[ROM_AREA_START], ROM_AREA_SIZE);
+	memset(STMemory_DirtyPages, 0, sizeof(STMemory_DirtyPages));
+}
+
+
+/**
+ * Return the copy in the key frame of the given RAM or ROM page,
+ * or NULL for pages that aren't part of the copy.
+ */
+static Uint8 *STMemory_KeyFramePage(Uint32 nPage)
+{
+	Uint32 nAddr = nPage << STMEMORY_PAGE_SHIFT;
+
+	if (nAddr < STRamEnd)
+		return pKeyFrameRam + nAddr;
+	if (nAddr >= ROM_AREA_START && nAddr < IO_AREA_START)
+		return pKeyFrameRam + STRamEnd + (nAddr - ROM_AREA_START);
+	return NULL;
+}
+
+
+/**
+ * Bring the key frame copy of the RAM and ROM area up to date by copying
+ * only the pages modified since it was taken, and clear the dirty pages.
+ * This makes a new key frame, like STMemory_SetKeyFrame() but cheaper.
+ * Return false if there's no key frame copy.
+ */
+bool STMemory_UpdateKeyFrame(void)
+{
+	Uint32 nPage;
+	Uint8 *pKey;
+
+	if (!pKeyFrameRam || nKeyFrameRamEnd != STRamEnd)
+	{
+		STMemory_SetKeyFrame();
+		return pKeyFrameRam && nKeyFrameRamEnd == STRamEnd;
+	}
+
+	for (nPage = 0; nPage < STMEMORY_NUM_PAGES; nPage++)
+	{
+		if (!STMemory_DirtyPages[nPage])
+			continue;
+		pKey = STMemory_KeyFramePage(nPage);
+		if (pKey)
+			memcpy(pKey, (Uint8 *)STRAM_ADDR(nPage << STMEMORY_PAGE_SHIFT), STMEMORY_PAGE_SIZE);
+		STMemory_DirtyPages[nPage] = 0;
+	}
+	return true;
+}
+
+
+/**
+ * Save/Restore the RAM and ROM area for checkpoints, whose RAM and ROM
+ * are the key frame copy (see STMemory_UpdateKeyFrame). Only the IO area
+ * is stored, when restoring the pages modified since the key frame are
+ * copied back from it.
+ */
+void STMemory_MemorySnapShot_CaptureCheckpoint(bool bSave)
+{
+	Uint32 nPage;
+	Uint8 *pKey;
+
+	MemorySnapShot_Store(&STRamEnd, sizeof(STRamEnd));
+
+	if (!bSave && pKeyFrameRam && nKeyFrameRamEnd == STRamEnd)
+	{
+		for (nPage = 0; nPage < STMEMORY_NUM_PAGES; nPage++)
+		{
+			if (!STMemory_DirtyPages[nPage])
+				continue;
+			pKey = STMemory_KeyFramePage(nPage);
+			if (pKey)
+				memcpy((Uint8 *)STRAM_ADDR(nPage << STMEMORY_PAGE_SHIFT), pKey, STMEMORY_PAGE_SIZE);
+			STMemory_DirtyPages[nPage] = 0;
+		}
+	}
+
+	MemorySnapShot_Store((Uint8 *)STRAM_ADDR(IO_AREA_START), 0x1000000 - IO_AREA_START);
 }
 
 
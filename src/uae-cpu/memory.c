@@ -254,6 +254,8 @@ static void STmem_lput(uaecptr addr, uae_u32 l)
 {
     addr -= STmem_start & STmem_mask;
     addr &= STmem_mask;
+    STMemory_SetDirty(addr);
+    STMemory_SetDirty(addr+3);
     do_put_mem_long(STmemory + addr, l);
 }
 
@@ -261,6 +263,8 @@ static void STmem_wput(uaecptr addr, uae_u32 w)
 {
     addr -= STmem_start & STmem_mask;
     addr &= STmem_mask;
+    STMemory_SetDirty(addr);
+    STMemory_SetDirty(addr+1);
     do_put_mem_word(STmemory + addr, w);
 }
 
@@ -268,6 +272,7 @@ static void STmem_bput(uaecptr addr, uae_u32 b)
 {
     addr -= STmem_start & STmem_mask;
     addr &= STmem_mask;
+    STMemory_SetDirty(addr);
     STmemory[addr] = b;
 }
 
@@ -344,6 +349,8 @@ static void SysMem_lput(uaecptr addr, uae_u32 l)
 
     addr -= STmem_start & STmem_mask;
     addr &= STmem_mask;
+    STMemory_SetDirty(addr);
+    STMemory_SetDirty(addr+3);
 
     do_put_mem_long(STmemory + addr, l);
 }
@@ -358,6 +365,8 @@ static void SysMem_wput(uaecptr addr, uae_u32 w)
 
     addr -= STmem_start & STmem_mask;
     addr &= STmem_mask;
+    STMemory_SetDirty(addr);
+    STMemory_SetDirty(addr+1);
 
     do_put_mem_word(STmemory + addr, w);
 }
@@ -372,6 +381,7 @@ static void SysMem_bput(uaecptr addr, uae_u32 b)
 
     addr -= STmem_start & STmem_mask;
     addr &= STmem_mask;
+    STMemory_SetDirty(addr);
     STmemory[addr] = b;
 }
 
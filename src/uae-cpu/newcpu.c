@@ -1732,10 +1732,54 @@ static int do_specialties (void)
 }
 
 
+/*
+ * Fast path for 'dbcc dn,*' busy loops (a DBcc branching to itself, often
+ * used as a delay). When such a DBcc was just executed and taken, run its
+ * following iterations here without going through the whole dispatch in
+ * m68k_run_1, as long as no interrupt is due. Cycles are counted exactly
+ * as the main loop would do, including pairing ; the last iteration (when
+ * dn.w is 0) and any pending interrupt are left to the main loop.
+ */
+static void m68k_run_dbcc_loop (uae_u32 opcode)
+{
+    uae_u32 srcreg = (opcode & 7);
+    uae_u16 src = m68k_dreg(regs, srcreg);
+
+    while ( ( src != 0 ) && ( PendingInterruptCount > 0 ) )
+    {
+	src--;
+	m68k_dreg(regs, srcreg) = (m68k_dreg(regs, srcreg) & ~0xffff) | src;
+	M68000_AddCyclesWithPairing(10);
+    }
+}
+
+
+/*
+ * m68k_run_1 is built in several variants, so that the common cases don't
+ * pay for per-instruction tests of features they don't use :
+ *  - M68K_RUN_PLAIN : no DSP, no cpu tracing (ST/STE/TT, Falcon without DSP)
+ *  - M68K_RUN_DSP   : run the DSP after each instruction
+ *  - M68K_RUN_DEBUG : debugger active, all features tested at run time
+ * m68k_go() selects the variant ; anything that changes the selection
+ * must set SPCFLAG_MODE_CHANGE so the current variant returns to m68k_go().
+ */
+#define M68K_RUN_PLAIN	0
+#define M68K_RUN_DSP	1
+#define M68K_RUN_DEBUG	2
+
+/* Force inlining, so each variant gets its own copy of the main loop */
+#ifdef __GNUC__
+#define RUN_1_INLINE	static __inline__ __attribute__ ((always_inline))
+#else
+#define RUN_1_INLINE	STATIC_INLINE
+#endif
+
 /* It's really sad to have two almost identical functions for this, but we
    do it all for performance... :( */
-static void m68k_run_1 (void)
+RUN_1_INLINE void m68k_run_1_variant (const int variant)
 {
+    const bool bDsp = ( variant == M68K_RUN_DEBUG ) ? bDspEnabled : ( variant == M68K_RUN_DSP );
+
 #ifdef DEBUG_PREFETCH
     uae_u8 saved_bytes[20];
     uae_u8 *oldpcp;
@@ -1770,7 +1814,7 @@ static void m68k_run_1 (void)
 #endif
 
 	/*m68k_dumpstate(stderr, NULL);*/
-	if (LOG_TRACE_LEVEL(TRACE_CPU_DISASM))
+	if (variant == M68K_RUN_DEBUG && LOG_TRACE_LEVEL(TRACE_CPU_DISASM))
 	{
 	    int FrameCycles, HblCounterVideo, LineCycles;
 
@@ -1793,7 +1837,7 @@ static void m68k_run_1 (void)
 	/* the error to build the exception stack frame */
 	BusErrorPC = m68k_getpc();
 
-	if (bDspEnabled)
+	if (bDsp)
 	    Cycles_SetCounter(CYCLES_COUNTER_CPU, 0);	/* to measure the total number of cycles spent in the cpu */
 
 	/* Uncomment following lines to call capslib's debugger after each instruction */
@@ -1819,6 +1863,13 @@ static void m68k_run_1 (void)
 	  nWaitStateCycles = 0;
 	}
 
+	/* Taken 'dbcc dn,*' (10 cycles and same PC) : run the next iterations */
+	/* directly, unless something needs to be done between 2 instructions */
+	if ( variant == M68K_RUN_PLAIN
+	    && cycles == 10 && ( opcode & 0xf0f8 ) == 0x50c8 && m68k_getpc() == BusErrorPC
+	    && !regs.spcflags )
+	    m68k_run_dbcc_loop (opcode);
+
 	/* We can have several interrupts at the same time before the next CPU instruction */
 	/* We must check for pending interrupt and call do_specialties_interrupt() only */
 	/* if the cpu is not in the STOP state. Else, the int could be acknowledged now */
@@ -1838,12 +1889,27 @@ static void m68k_run_1 (void)
 	}
 
 	/* Run DSP 56k code if necessary */
-	if (bDspEnabled) {
+	if (bDsp) {
 	    DSP_Run( Cycles_GetCounter(CYCLES_COUNTER_CPU) * 2);
 	}
     }
 }
 
+static void m68k_run_1 (void)
+{
+    m68k_run_1_variant (M68K_RUN_PLAIN);
+}
+
+static void m68k_run_1_dsp (void)
+{
+    m68k_run_1_variant (M68K_RUN_DSP);
+}
+
+static void m68k_run_1_debug (void)
+{
+    m68k_run_1_variant (M68K_RUN_DEBUG);
+}
+
 
 /* Same thing, but don't use prefetch to get opcode.  */
 static void m68k_run_2 (void)
@@ -1921,8 +1987,14 @@ void m68k_go (int may_quit)
 
     in_m68k_go++;
     while (!(regs.spcflags & SPCFLAG_BRK)) {
-        if(currprefs.cpu_compatible)
-          m68k_run_1();
+        if(currprefs.cpu_compatible) {
+          if ((regs.spcflags & SPCFLAG_DEBUGGER) || LOG_TRACE_LEVEL(TRACE_CPU_DISASM))
+            m68k_run_1_debug();
+          else if (bDspEnabled)
+            m68k_run_1_dsp();
+          else
+            m68k_run_1();
+        }
          else
           m68k_run_2();
     }
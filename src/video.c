@@ -405,6 +405,7 @@ const char Video_fileid[] = "Hatari video.c : " __DATE__ " " __TIME__;
 int STRes = ST_LOW_RES;                         /* current ST resolution */
 int TTRes;                                      /* TT shifter resolution mode */
 int nFrameSkips;                                /* speed up by skipping video frames */
+bool bSkipVideoFrame;                           /* don't draw the current frame, even if not skipped by nFrameSkips */
 
 bool bUseHighRes;                               /* Use hi-res (ie Mono monitor) */
 int OverscanMode;                               /* OVERSCANMODE_xxxx for current display frame */
@@ -2856,7 +2857,7 @@ bool Video_RenderTTScreen(void)
 static void Video_DrawScreen(void)
 {
 	/* Skip frame if need to */
-	if (nVBLs % (nFrameSkips+1))
+	if (nVBLs % (nFrameSkips+1) || bSkipVideoFrame)
 		return;
 
 	/* Use extended VDI resolution?
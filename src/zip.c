@@ -13,6 +13,7 @@ const char ZIP_fileid[] = "Hatari zip.c : " __DATE__ " " __TIME__;
 #include <unistd.h>
 #include <dirent.h>
 #include <sys/types.h>
+#include <sys/stat.h>
 #include <zlib.h>
 
 #include "main.h"
@@ -37,8 +38,50 @@ const char ZIP_fileid[] = "Hatari zip.c : " __DATE__ " " __TIME__;
 
 #define ZIP_PATH_MAX  256
 
+#define ZIP_INDEX_MAX     8                  /* archives whose directory is kept */
+#define ZIP_IMAGES_MAX    8                  /* extracted disk images kept */
+#define ZIP_IMAGES_SIZE   (32*1024*1024)     /* max bytes used by the extracted images */
+
 #if HAVE_LIBZ
 
+/* A file in the central directory of an archive */
+typedef struct
+{
+	char *name;
+	uLong size;                 /* uncompressed size */
+	unz_file_pos pos;           /* to go to this file without searching its name */
+} zip_entry;
+
+/* The central directory of an archive, read once and kept as long
+ * as the archive's modification time and size don't change */
+typedef struct
+{
+	char *zipname;
+	time_t mtime;
+	off_t zipsize;
+	zip_entry *entries;
+	int nentries;
+	Uint32 lastuse;
+} zip_index;
+
+/* A disk image already extracted from an archive (and uncompressed
+ * for .msa), so swapping disks doesn't inflate it again */
+typedef struct
+{
+	char *zipname;
+	time_t mtime;
+	off_t zipsize;
+	char *name;
+	Uint8 *buffer;
+	long size;
+	int imagetype;
+	Uint32 lastuse;
+} zip_image;
+
+static zip_index ZipIndexes[ZIP_INDEX_MAX];
+static zip_image ZipImages[ZIP_IMAGES_MAX];
+static Uint32 nZipUseCount;
+
 /* Possible disk image extensions to scan for */
 static const char * const pszDiskNameExts[] =
 {
@@ -83,21 +126,66 @@ static int Zip_FileNameHasSlash(const char *fn)
 
 /*-----------------------------------------------------------------------*/
 /**
- * Returns a list of files from a zip file. returns NULL on failure,
- * returns a pointer to an array of strings if successful. Sets nfiles
- * to the number of files.
+ * Free the memory that has been allocated for an archive's directory.
  */
-zip_dir *ZIP_GetFiles(const char *pszFileName)
+static void ZIP_FreeIndex(zip_index *zi)
 {
-	int nfiles;
-	unsigned int i;
+	while (zi->nentries > 0)
+	{
+		zi->nentries--;
+		free(zi->entries[zi->nentries].name);
+	}
+	free(zi->entries);
+	free(zi->zipname);
+	memset(zi, 0, sizeof(*zi));
+}
+
+
+/*-----------------------------------------------------------------------*/
+/**
+ * Return the central directory of a zip file, read from the archive
+ * only if it's not already known (or if the file changed since).
+ * Returns NULL on failure.
+ */
+static zip_index *ZIP_GetIndex(const char *pszFileName)
+{
+	struct stat st;
 	unz_global_info gi;
-	int err;
-	unzFile uf;
-	char **filelist;
 	unz_file_info file_info;
 	char filename_inzip[ZIP_PATH_MAX];
-	zip_dir *zd;
+	unzFile uf;
+	zip_index *zi;
+	zip_entry *entries;
+	unsigned int i;
+	int n;
+
+	if (stat(pszFileName, &st) != 0)
+	{
+		Log_Printf(LOG_ERROR, "ZIP_GetFiles: Cannot open %s\n", pszFileName);
+		return NULL;
+	}
+
+	/* Already read? Else replace the previous index of this archive,
+	 * or an unused one, or the least recently used one */
+	zi = &ZipIndexes[0];
+	for (n = 0; n < ZIP_INDEX_MAX; n++)
+	{
+		if (ZipIndexes[n].zipname && strcmp(ZipIndexes[n].zipname, pszFileName) == 0)
+		{
+			zi = &ZipIndexes[n];
+			if (zi->mtime == st.st_mtime && zi->zipsize == st.st_size)
+			{
+				zi->lastuse = ++nZipUseCount;
+				return zi;
+			}
+			break;
+		}
+		if (!ZipIndexes[n].zipname)
+			zi = &ZipIndexes[n];
+		else if (zi->zipname && ZipIndexes[n].lastuse < zi->lastuse)
+			zi = &ZipIndexes[n];
+	}
+	ZIP_FreeIndex(zi);
 
 	uf = unzOpen(pszFileName);
 	if (uf == NULL)
@@ -106,67 +194,120 @@ zip_dir *ZIP_GetFiles(const char *pszFileName)
 		return NULL;
 	}
 
-	err = unzGetGlobalInfo(uf,&gi);
-	if (err != UNZ_OK)
+	if (unzGetGlobalInfo(uf, &gi) != UNZ_OK)
 	{
-		Log_Printf(LOG_ERROR, "Error %d with zipfile in unzGetGlobalInfo \n",err);
+		Log_Printf(LOG_ERROR, "Error with zipfile in unzGetGlobalInfo \n");
+		unzClose(uf);
 		return NULL;
 	}
 
-	/* allocate a file list */
-	filelist = (char **)malloc(gi.number_entry*sizeof(char *));
-	if (!filelist)
+	entries = calloc(gi.number_entry + 1, sizeof(zip_entry));
+	if (!entries)
 	{
 		perror("ZIP_GetFiles");
+		unzClose(uf);
 		return NULL;
 	}
-
-	nfiles = gi.number_entry;  /* set the number of files */
+	zi->entries = entries;
 
 	for (i = 0; i < gi.number_entry; i++)
 	{
-		err = unzGetCurrentFileInfo(uf, &file_info, filename_inzip, ZIP_PATH_MAX, NULL, 0, NULL, 0);
-		if (err != UNZ_OK)
+		if (unzGetCurrentFileInfo(uf, &file_info, filename_inzip, ZIP_PATH_MAX, NULL, 0, NULL, 0) != UNZ_OK
+		    || unzGetFilePos(uf, &entries[i].pos) != UNZ_OK)
 		{
-			free(filelist);
-			return NULL;
+			Log_Printf(LOG_ERROR, "ZIP_GetFiles: Error in ZIP-file\n");
+			break;
 		}
 
-		filelist[i] = (char *)malloc(strlen(filename_inzip) + 1);
-		if (!filelist[i])
+		entries[i].name = strdup(filename_inzip);
+		if (!entries[i].name)
 		{
 			perror("ZIP_GetFiles");
-			free(filelist);
-			return NULL;
+			break;
 		}
+		entries[i].size = file_info.uncompressed_size;
+		zi->nentries++;
 
-		strcpy(filelist[i], filename_inzip);
-		if ((i+1) < gi.number_entry)
+		if ((i+1) < gi.number_entry && unzGoToNextFile(uf) != UNZ_OK)
 		{
-			err = unzGoToNextFile(uf);
-			if (err != UNZ_OK)
-			{
-				Log_Printf(LOG_ERROR, "ZIP_GetFiles: Error in ZIP-file\n");
-				/* deallocate memory */
-				for (; i > 0; i--)
-					free(filelist[i]);
-				free(filelist);
-				return NULL;
-			}
+			Log_Printf(LOG_ERROR, "ZIP_GetFiles: Error in ZIP-file\n");
+			break;
 		}
 	}
 
 	unzClose(uf);
 
+	if (zi->nentries != (int)gi.number_entry)
+	{
+		ZIP_FreeIndex(zi);
+		return NULL;
+	}
+
+	zi->zipname = strdup(pszFileName);
+	if (!zi->zipname)
+	{
+		perror("ZIP_GetFiles");
+		ZIP_FreeIndex(zi);
+		return NULL;
+	}
+	zi->mtime = st.st_mtime;
+	zi->zipsize = st.st_size;
+	zi->lastuse = ++nZipUseCount;
+
+	return zi;
+}
+
+
+/*-----------------------------------------------------------------------*/
+/**
+ * Returns a list of files from a zip file. returns NULL on failure,
+ * returns a pointer to an array of strings if successful. Sets nfiles
+ * to the number of files.
+ */
+zip_dir *ZIP_GetFiles(const char *pszFileName)
+{
+	zip_index *zi;
+	char **filelist;
+	zip_dir *zd;
+	int i;
+
+	zi = ZIP_GetIndex(pszFileName);
+	if (!zi)
+		return NULL;
+
+	/* allocate a file list */
+	filelist = (char **)malloc((zi->nentries + 1) * sizeof(char *));
+	if (!filelist)
+	{
+		perror("ZIP_GetFiles");
+		return NULL;
+	}
+
+	for (i = 0; i < zi->nentries; i++)
+	{
+		filelist[i] = strdup(zi->entries[i].name);
+		if (!filelist[i])
+		{
+			perror("ZIP_GetFiles");
+			/* deallocate memory */
+			while (i-- > 0)
+				free(filelist[i]);
+			free(filelist);
+			return NULL;
+		}
+	}
+
 	zd = (zip_dir *)malloc(sizeof(zip_dir));
 	if (!zd)
 	{
 		perror("ZIP_GetFiles");
+		for (i = 0; i < zi->nentries; i++)
+			free(filelist[i]);
 		free(filelist);
 		return NULL;
 	}
 	zd->names = filelist;
-	zd->nfiles = nfiles;
+	zd->nfiles = zi->nentries;
 
 	return zd;
 }
@@ -330,53 +471,57 @@ struct dirent **ZIP_GetFilesDir(const zip_dir *zip, const char *dir, int *entrie
 
 /*-----------------------------------------------------------------------*/
 /**
- * Check an image file in the archive, return the uncompressed length
+ * Return the file named filename in the archive's directory, or NULL
  */
-static long ZIP_CheckImageFile(unzFile uf, char *filename, int namelen, int *pImageType)
+static const zip_entry *ZIP_FindFile(const zip_index *zi, const char *filename)
 {
-	unz_file_info file_info;
+	int i;
 
-	if (unzLocateFile(uf,filename, 0) != UNZ_OK)
+	for (i = 0; i < zi->nentries; i++)
 	{
-		Log_Printf(LOG_ERROR, "Error: File \"%s\" not found in the archive!\n", filename);
-		return -1;
+		/* same comparison as unzLocateFile() */
+		if (unzStringFileNameCompare(zi->entries[i].name, filename, 0) == 0)
+			return &zi->entries[i];
 	}
+	return NULL;
+}
 
-	if (unzGetCurrentFileInfo(uf, &file_info, filename, namelen, NULL, 0, NULL, 0) != UNZ_OK)
-	{
-		Log_Printf(LOG_ERROR, "Error with zipfile in unzGetCurrentFileInfo\n");
-		return -1;
-	}
 
+/*-----------------------------------------------------------------------*/
+/**
+ * Check an image file in the archive, return the uncompressed length
+ */
+static long ZIP_CheckImageFile(const zip_entry *entry, int *pImageType)
+{
 	/* check for .stx, .ipf, .msa, .dim or .st extension */
-	if (STX_FileNameIsSTX(filename, false))
+	if (STX_FileNameIsSTX(entry->name, false))
 	{
 		*pImageType = FLOPPY_IMAGE_TYPE_STX;
-		return file_info.uncompressed_size;
+		return entry->size;
 	}
 
-	if (IPF_FileNameIsIPF(filename, false))
+	if (IPF_FileNameIsIPF(entry->name, false))
 	{
 		*pImageType = FLOPPY_IMAGE_TYPE_IPF;
-		return file_info.uncompressed_size;
+		return entry->size;
 	}
 
-	if (MSA_FileNameIsMSA(filename, false))
+	if (MSA_FileNameIsMSA(entry->name, false))
 	{
 		*pImageType = FLOPPY_IMAGE_TYPE_MSA;
-		return file_info.uncompressed_size;
+		return entry->size;
 	}
 
-	if (ST_FileNameIsST(filename, false))
+	if (ST_FileNameIsST(entry->name, false))
 	{
 		*pImageType = FLOPPY_IMAGE_TYPE_ST;
-		return file_info.uncompressed_size;
+		return entry->size;
 	}
 
-	if (DIM_FileNameIsDIM(filename, false))
+	if (DIM_FileNameIsDIM(entry->name, false))
 	{
 		*pImageType = FLOPPY_IMAGE_TYPE_DIM;
-		return file_info.uncompressed_size;
+		return entry->size;
 	}
 
 	Log_Printf(LOG_ERROR, "Not an .ST, .MSA, .DIM, .IPF or .STX file.\n");
@@ -385,96 +530,65 @@ static long ZIP_CheckImageFile(unzFile uf, char *filename, int namelen, int *pIm
 
 /*-----------------------------------------------------------------------*/
 /**
- * Return the first matching file in a zip, or NULL on failure.
- * String buffer size is ZIP_PATH_MAX
+ * Return the first matching file in a zip's directory, or NULL on failure.
  */
-static char *ZIP_FirstFile(const char *filename, const char * const ppsExts[])
+static const zip_entry *ZIP_FirstFile(const zip_index *zi, const char * const ppsExts[])
 {
-	zip_dir *files;
 	int i, j;
-	char *name;
-
-	files = ZIP_GetFiles(filename);
-	if (files == NULL)
-		return NULL;
-
-	name = malloc(ZIP_PATH_MAX);
-	if (!name)
-	{
-		perror("ZIP_FirstFile");
-		ZIP_FreeZipDir(files);
-		return NULL;
-	}
 
 	/* Do we have to scan for a certain extension? */
 	if (ppsExts)
 	{
-		name[0] = '\0';
-		for(i = files->nfiles-1; i >= 0; i--)
+		for (i = 0; i < zi->nentries; i++)
 		{
 			for (j = 0; ppsExts[j] != NULL; j++)
 			{
-				if (File_DoesFileExtensionMatch(files->names[i], ppsExts[j]))
-				{
-					strncpy(name, files->names[i], ZIP_PATH_MAX);
-					break;
-				}
+				if (File_DoesFileExtensionMatch(zi->entries[i].name, ppsExts[j]))
+					return &zi->entries[i];
 			}
 		}
-	}
-	else
-	{
-		/* There was no extension given -> use the very first name */
-		strncpy(name, files->names[0], ZIP_PATH_MAX);
-	}
-
-	/* free the files */
-	ZIP_FreeZipDir(files);
-
-	if (name[0] == '\0')
-	{
-		free(name);
 		return NULL;
 	}
 
-	return name;
+	/* There was no extension given -> use the very first name */
+	if (zi->nentries > 0)
+		return &zi->entries[0];
+	return NULL;
 }
 
 
 /*-----------------------------------------------------------------------*/
 /**
- * Extract a file (filename) from a ZIP-file (uf), the number of 
- * bytes to uncompress is size. Returns a pointer to a buffer containing
- * the uncompressed data, or NULL.
+ * Extract a file (entry) from a ZIP-file (pszFileName).
+ * Returns a pointer to a buffer containing the uncompressed data, or NULL.
  */
-static void *ZIP_ExtractFile(unzFile uf, const char *filename, uLong size)
+static void *ZIP_ExtractFile(const char *pszFileName, const zip_entry *entry)
 {
 	int err = UNZ_OK;
-	char filename_inzip[ZIP_PATH_MAX];
-	void* buf;
-	uInt size_buf;
-	unz_file_info file_info;
-
+	unzFile uf;
+	Uint8 *buf;
+	uLong done;
 
-	if (unzLocateFile(uf,filename, 0) != UNZ_OK)
+	uf = unzOpen(pszFileName);
+	if (uf == NULL)
 	{
-		Log_Printf(LOG_ERROR, "ZIP_ExtractFile: could not find file in archive\n");
+		Log_Printf(LOG_ERROR, "Cannot open %s\n", pszFileName);
 		return NULL;
 	}
 
-	err = unzGetCurrentFileInfo(uf,&file_info,filename_inzip,sizeof(filename_inzip),NULL,0,NULL,0);
-
-	if (err != UNZ_OK)
+	/* go straight to the file's entry, no need to search its name */
+	if (unzGoToFilePos(uf, &entry->pos) != UNZ_OK)
 	{
-		Log_Printf(LOG_ERROR, "ZIP_ExtractFile: could not get file info\n");
+		Log_Printf(LOG_ERROR, "ZIP_ExtractFile: could not find file in archive\n");
+		unzClose(uf);
 		return NULL;
 	}
 
-	size_buf = size;
-	buf = malloc(size_buf);
+	buf = malloc(entry->size ? entry->size : 1);
 	if (!buf)
 	{
 		perror("ZIP_ExtractFile");
+		unzClose(uf);
 		return NULL;
 	}
 
@@ -483,42 +597,148 @@ static void *ZIP_ExtractFile(unzFile uf, const char *filename, uLong size)
 	{
 		Log_Printf(LOG_ERROR, "ZIP_ExtractFile: could not open file\n");
 		free(buf);
+		unzClose(uf);
 		return NULL;
 	}
 
+	done = 0;
 	do
 	{
-		err = unzReadCurrentFile(uf,buf,size_buf);
+		err = unzReadCurrentFile(uf, buf + done, entry->size - done);
 		if (err < 0)
 		{
 			Log_Printf(LOG_ERROR, "ZIP_ExtractFile: could not read file\n");
-			return NULL;
+			free(buf);
+			buf = NULL;
+			break;
 		}
+		done += err;
 	}
-	while (err > 0);
+	while (err > 0 && done < entry->size);
+
+	unzCloseCurrentFile(uf);
+	unzClose(uf);
 
 	return buf;
 }
 
 
+/*-----------------------------------------------------------------------*/
+/**
+ * If the disk image 'entry' of archive 'zi' was already extracted,
+ * return a copy of it and set its size and type. Else return NULL.
+ */
+static Uint8 *ZIP_GetCachedImage(const zip_index *zi, const zip_entry *entry, long *pImageSize, int *pImageType)
+{
+	zip_image *zimg;
+	Uint8 *buf;
+	int i;
+
+	for (i = 0; i < ZIP_IMAGES_MAX; i++)
+	{
+		zimg = &ZipImages[i];
+		if (zimg->buffer && zimg->mtime == zi->mtime && zimg->zipsize == zi->zipsize
+		    && strcmp(zimg->zipname, zi->zipname) == 0 && strcmp(zimg->name, entry->name) == 0)
+		{
+			/* the caller owns (and may modify) the returned buffer */
+			buf = malloc(zimg->size);
+			if (!buf)
+				return NULL;
+			memcpy(buf, zimg->buffer, zimg->size);
+			zimg->lastuse = ++nZipUseCount;
+			*pImageSize = zimg->size;
+			*pImageType = zimg->imagetype;
+			return buf;
+		}
+	}
+	return NULL;
+}
+
+
+/*-----------------------------------------------------------------------*/
+/**
+ * Free an extracted disk image
+ */
+static void ZIP_FreeImage(zip_image *zimg)
+{
+	free(zimg->zipname);
+	free(zimg->name);
+	free(zimg->buffer);
+	memset(zimg, 0, sizeof(*zimg));
+}
+
+
+/*-----------------------------------------------------------------------*/
+/**
+ * Keep a copy of an extracted disk image, dropping the least recently
+ * used ones if there are too many of them.
+ */
+static void ZIP_CacheImage(const zip_index *zi, const zip_entry *entry, const Uint8 *pBuffer, long ImageSize, int ImageType)
+{
+	zip_image *zimg, *lru;
+	long total;
+	int i;
+
+	if (ImageSize <= 0 || ImageSize > ZIP_IMAGES_SIZE)
+		return;
+
+	for (;;)
+	{
+		total = ImageSize;
+		zimg = lru = NULL;
+		for (i = 0; i < ZIP_IMAGES_MAX; i++)
+		{
+			if (!ZipImages[i].buffer)
+				zimg = &ZipImages[i];
+			else
+			{
+				total += ZipImages[i].size;
+				if (!lru || ZipImages[i].lastuse < lru->lastuse)
+					lru = &ZipImages[i];
+			}
+		}
+		if (zimg && total <= ZIP_IMAGES_SIZE)
+			break;
+		ZIP_FreeImage(lru);
+	}
+
+	zimg->zipname = strdup(zi->zipname);
+	zimg->name = strdup(entry->name);
+	zimg->buffer = malloc(ImageSize);
+	if (!zimg->zipname || !zimg->name || !zimg->buffer)
+	{
+		ZIP_FreeImage(zimg);
+		return;
+	}
+	memcpy(zimg->buffer, pBuffer, ImageSize);
+	zimg->mtime = zi->mtime;
+	zimg->zipsize = zi->zipsize;
+	zimg->size = ImageSize;
+	zimg->imagetype = ImageType;
+	zimg->lastuse = ++nZipUseCount;
+}
+
+
 /*-----------------------------------------------------------------------*/
 /**
  * Load disk image from a .ZIP archive into memory, set  the number
  * of bytes loaded into pImageSize and return the data or NULL on error.
+ * Archives' directories and extracted images are cached, so inserting
+ * again a disk from the same archive doesn't need to uncompress it.
  */
 Uint8 *ZIP_ReadDisk(int Drive, const char *pszFileName, const char *pszZipPath, long *pImageSize, int *pImageType)
 {
 	uLong ImageSize=0;
-	unzFile uf=NULL;
+	zip_index *zi;
+	const zip_entry *entry;
 	Uint8 *buf;
-	char *path;
 	Uint8 *pDiskBuffer = NULL;
 
 	*pImageSize = 0;
 	*pImageType = FLOPPY_IMAGE_TYPE_NONE;
 
-	uf = unzOpen(pszFileName);
-	if (uf == NULL)
+	zi = ZIP_GetIndex(pszFileName);
+	if (zi == NULL)
 	{
 		Log_Printf(LOG_ERROR, "Cannot open %s\n", pszFileName);
 		return NULL;
@@ -526,42 +746,35 @@ Uint8 *ZIP_ReadDisk(int Drive, const char *pszFileName, const char *pszZipPath,
 
 	if (pszZipPath == NULL || pszZipPath[0] == 0)
 	{
-		path = ZIP_FirstFile(pszFileName, pszDiskNameExts);
-		if (path == NULL)
+		entry = ZIP_FirstFile(zi, pszDiskNameExts);
+		if (entry == NULL)
 		{
 			Log_Printf(LOG_ERROR, "Cannot open %s\n", pszFileName);
-			unzClose(uf);
 			return NULL;
 		}
 	}
 	else
 	{
-		path = malloc(ZIP_PATH_MAX);
-		if (path == NULL)
+		entry = ZIP_FindFile(zi, pszZipPath);
+		if (entry == NULL)
 		{
-			perror("ZIP_ReadDisk");
-			unzClose(uf);
+			Log_Printf(LOG_ERROR, "Error: File \"%s\" not found in the archive!\n", pszZipPath);
 			return NULL;
 		}
-		strncpy(path, pszZipPath, ZIP_PATH_MAX);
-		path[ZIP_PATH_MAX-1] = '\0';
 	}
 
-	ImageSize = ZIP_CheckImageFile(uf, path, ZIP_PATH_MAX, pImageType);
+	pDiskBuffer = ZIP_GetCachedImage(zi, entry, pImageSize, pImageType);
+	if (pDiskBuffer)
+		return pDiskBuffer;
+
+	ImageSize = ZIP_CheckImageFile(entry, pImageType);
 	if (ImageSize <= 0)
 	{
-		unzClose(uf);
-		free(path);
 		return NULL;
 	}
 
 	/* extract to buf */
-	buf = ZIP_ExtractFile(uf, path, ImageSize);
-
-	unzCloseCurrentFile(uf);
-	unzClose(uf);
-	free(path);
-	path = NULL;
+	buf = ZIP_ExtractFile(pszFileName, entry);
 
 	if (buf == NULL)
 	{
@@ -572,6 +785,7 @@ Uint8 *ZIP_ReadDisk(int Drive, const char *pszFileName, const char *pszZipPath,
 	case FLOPPY_IMAGE_TYPE_IPF:
 #ifndef HAVE_CAPSIMAGE
 		Log_AlertDlg(LOG_ERROR, "This version of Hatari was not built with IPF support, this disk image can't be handled.");
+		free(buf);
 		return NULL;
 #else
 		/* return buffer */
@@ -600,10 +814,11 @@ Uint8 *ZIP_ReadDisk(int Drive, const char *pszFileName, const char *pszZipPath,
 		pDiskBuffer = buf;
 		break;
 	}
-	
+
 	if (pDiskBuffer)
 	{
 		*pImageSize = ImageSize;
+		ZIP_CacheImage(zi, entry, pDiskBuffer, ImageSize, *pImageType);
 	}
 	return pDiskBuffer;
 }
@@ -616,60 +831,52 @@ Uint8 *ZIP_ReadDisk(int Drive, const char *pszFileName, const char *pszZipPath,
  */
 Uint8 *ZIP_ReadFirstFile(const char *pszFileName, long *pImageSize, const char * const ppszExts[])
 {
-	unzFile uf=NULL;
+	zip_index *zi;
+	const zip_entry *entry;
 	Uint8 *pBuffer;
-	char *pszZipPath;
-	unz_file_info file_info;
 
 	*pImageSize = 0;
 
-	/* Open the ZIP file */
-	uf = unzOpen(pszFileName);
-	if (uf == NULL)
+	/* Get the directory of the ZIP file */
+	zi = ZIP_GetIndex(pszFileName);
+	if (zi == NULL)
 	{
 		Log_Printf(LOG_ERROR, "Cannot open '%s'\n", pszFileName);
 		return NULL;
 	}
 
 	/* Locate the first file in the ZIP archive */
-	pszZipPath = ZIP_FirstFile(pszFileName, ppszExts);
-	if (pszZipPath == NULL)
+	entry = ZIP_FirstFile(zi, ppszExts);
+	if (entry == NULL)
 	{
 		Log_Printf(LOG_ERROR, "Failed to locate first file in '%s'\n", pszFileName);
-		unzClose(uf);
-		return NULL;
-	}
-
-	if (unzLocateFile(uf, pszZipPath, 0) != UNZ_OK)
-	{
-		Log_Printf(LOG_ERROR, "Error: Can not locate '%s' in the archive!\n", pszZipPath);
-		free(pszZipPath);
-		return NULL;
-	}
-
-	/* Get file information (file size!) */
-	if (unzGetCurrentFileInfo(uf, &file_info, pszZipPath, ZIP_PATH_MAX, NULL, 0, NULL, 0) != UNZ_OK)
-	{
-		Log_Printf(LOG_ERROR, "Error with zipfile in unzGetCurrentFileInfo.\n");
-		free(pszZipPath);
 		return NULL;
 	}
 
 	/* Extract to buffer */
-	pBuffer = ZIP_ExtractFile(uf, pszZipPath, file_info.uncompressed_size);
-
-	/* And close the file */
-	unzCloseCurrentFile(uf);
-	unzClose(uf);
-
-	free(pszZipPath);
+	pBuffer = ZIP_ExtractFile(pszFileName, entry);
 
 	if (pBuffer)
-		*pImageSize = file_info.uncompressed_size;
+		*pImageSize = entry->size;
 
 	return pBuffer;
 }
 
+
+/*-----------------------------------------------------------------------*/
+/**
+ * Free the cached archive directories and extracted disk images.
+ */
+void ZIP_UnInit(void)
+{
+	int i;
+
+	for (i = 0; i < ZIP_INDEX_MAX; i++)
+		ZIP_FreeIndex(&ZipIndexes[i]);
+	for (i = 0; i < ZIP_IMAGES_MAX; i++)
+		ZIP_FreeImage(&ZipImages[i]);
+}
+
 #else
 
 bool ZIP_FileNameIsZIP(const char *pszFileName)
@@ -691,6 +898,9 @@ zip_dir *ZIP_GetFiles(const char *pszFileName)
 void ZIP_FreeZipDir(zip_dir *f_zd)
 {
 }
+void ZIP_UnInit(void)
+{
+}
 
 #endif  /* HAVE_LIBZ */
 